@@ -7,6 +7,9 @@
 #include <string>
 #include <fstream>
 #include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <vector>
 
 std::string readFileContents(std::string path) {
     std::ifstream in(path);
@@ -21,4 +24,79 @@ void appendShaderFolderIfNotPresent(std::string& path) {
         path = "resources/shaders/" + path;
     }
 }
+// directory part of a path including the trailing slash, empty for a bare file name
+std::string directoryOf(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+// appends source to out with every #include "file" line replaced by the contents of the file (relative to the
+// including file). Every file is included at most once. The #line directives keep compile errors pointing at the
+// right line, the source string number is the position of the file in included (the main file is 0).
+void expandShaderIncludes(const std::string& path, const std::string& source, std::vector<std::string>& included,
+                          std::string& out) {
+    unsigned int file = 0;
+    while (file < included.size() && included[file] != path)
+        file++;
+    std::istringstream lines(source);
+    std::string line;
+    unsigned int number = 0;
+    while (std::getline(lines, line)) {
+        number++;
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line.compare(start, 8, "#include") != 0) {
+            out += line;
+            out += '\n';
+            continue;
+        }
+        size_t open = line.find('"', start);
+        size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+        if (close == std::string::npos) {
+            std::cout << "ERROR::SHADER::MALFORMED_INCLUDE " << path << ":" << number << std::endl;
+            continue;
+        }
+        std::string includePath = directoryOf(path) + line.substr(open + 1, close - open - 1);
+        bool seen = false;
+        for (const std::string& name : included)
+            seen = seen || name == includePath;
+        if (seen)
+            continue;
+
+        std::ifstream in(includePath);
+        if (!in) {
+            std::cout << "ERROR::SHADER::INCLUDE_NOT_FOUND " << includePath << " (included from " << path << ")" << std::endl;
+            continue;
+        }
+        std::stringstream contents;
+        contents << in.rdbuf();
+        included.push_back(includePath);
+        out += "#line 1 " + std::to_string(included.size() - 1) + "\n";
+        expandShaderIncludes(includePath, contents.str(), included, out);
+        out += "#line " + std::to_string(number + 1) + " " + std::to_string(file) + "\n";
+    }
+}
+
+// resolves the includes of a shader source and adds defines ("NAME" or "NAME value") right after its #version
+// line, which is how one file is built in several permutations. The paths of the included files are appended
+// to files if given.
+std::string preprocessShader(const std::string& path, const std::string& source,
+                             const std::vector<std::string>& defines = {}, std::vector<std::string>* files = nullptr) {
+    std::vector<std::string> included(1, path);
+    std::string expanded;
+    expandShaderIncludes(path, source, included, expanded);
+    if (files)
+        files->insert(files->end(), included.begin() + 1, included.end());
+    if (defines.empty())
+        return expanded;
+
+    size_t version = expanded.find("#version");
+    size_t insert = version == std::string::npos ? 0 : expanded.find('\n', version);
+    insert = insert == std::string::npos ? expanded.size() : insert + 1;
+    std::string block;
+    for (const std::string& define : defines)
+        block += "#define " + define + "\n";
+    if (version != std::string::npos)
+        block += "#line " + std::to_string(std::count(expanded.begin(), expanded.begin() + insert, '\n') + 1) + " 0\n";
+    return expanded.insert(insert, block);
+}
 #endif //PROJECT_BASE_COMMON_H
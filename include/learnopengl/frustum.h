@@ -0,0 +1,140 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define FRUSTUM_SSE 1
+#endif
+
+// axis aligned bounding box of a mesh in model space
+struct AABB {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// bounds of box after transforming it by model, still axis aligned and in general larger than the transformed box
+inline AABB transformBounds(const AABB &box, const glm::mat4 &model)
+{
+    glm::vec3 center = glm::vec3(model * glm::vec4((box.min + box.max) * 0.5f, 1.0f));
+    glm::vec3 extent = (box.max - box.min) * 0.5f;
+    glm::vec3 worldExtent = glm::abs(glm::vec3(model[0])) * extent.x
+                          + glm::abs(glm::vec3(model[1])) * extent.y
+                          + glm::abs(glm::vec3(model[2])) * extent.z;
+    return {center - worldExtent, center + worldExtent};
+}
+
+// the six planes of a view frustum in world space, a point p is inside a plane when dot(plane.xyz, p) + plane.w >= 0
+struct Frustum {
+    glm::vec4 planes[6];
+
+    // extracts the planes from the rows of projection * view (Gribb and Hartmann)
+    static Frustum fromMatrix(const glm::mat4 &viewProjection)
+    {
+        glm::vec4 rows[4];
+        for (int row = 0; row < 4; row++)
+            rows[row] = glm::vec4(viewProjection[0][row], viewProjection[1][row], viewProjection[2][row], viewProjection[3][row]);
+        Frustum frustum;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            frustum.planes[axis * 2] = rows[3] + rows[axis];
+            frustum.planes[axis * 2 + 1] = rows[3] - rows[axis];
+        }
+        return frustum;
+    }
+};
+
+// Tests world space boxes against a frustum four at a time.
+//
+// The boxes are kept as structure of arrays, one array per bound coordinate, so four boxes load into one SSE
+// register per coordinate. For each plane the corner of a box furthest along the plane normal is the max or the
+// min of each coordinate depending only on the sign of the normal, the same for every box, so picking the corner
+// is a choice of arrays rather than a per box select. A box is culled when that corner lies behind any plane.
+// The test is conservative: boxes near a frustum corner can be kept although they are outside.
+class FrustumCuller {
+public:
+    void clear()
+    {
+        for (std::vector<float> &coordinate : bounds)
+            coordinate.clear();
+        count = 0;
+    }
+
+    // adds a box, returns its index into the visibility
+    size_t add(const AABB &box)
+    {
+        const float values[6] = {box.min.x, box.min.y, box.min.z, box.max.x, box.max.y, box.max.z};
+        for (int coordinate = 0; coordinate < 6; coordinate++)
+            bounds[coordinate].push_back(values[coordinate]);
+        return count++;
+    }
+
+    size_t size() const { return count; }
+
+    // tests every box added since clear, visible(i) tells the result for box i
+    void cull(const Frustum &frustum)
+    {
+        // padding to a whole number of batches, the padded boxes are never read back
+        size_t padded = (count + BATCH - 1) / BATCH * BATCH;
+        for (std::vector<float> &coordinate : bounds)
+            coordinate.resize(padded, 0.0f);
+        outside.assign(padded, 0);
+
+        // the coordinate arrays holding the corner furthest along each plane normal
+        const float *corners[6][3];
+        for (int plane = 0; plane < 6; plane++)
+        {
+            const glm::vec4 &normal = frustum.planes[plane];
+            corners[plane][0] = bounds[normal.x >= 0.0f ? MAX_X : MIN_X].data();
+            corners[plane][1] = bounds[normal.y >= 0.0f ? MAX_Y : MIN_Y].data();
+            corners[plane][2] = bounds[normal.z >= 0.0f ? MAX_Z : MIN_Z].data();
+        }
+#ifdef FRUSTUM_SSE
+        __m128 planes[6][4];
+        for (int plane = 0; plane < 6; plane++)
+            for (int component = 0; component < 4; component++)
+                planes[plane][component] = _mm_set1_ps(frustum.planes[plane][component]);
+        const __m128 zero = _mm_setzero_ps();
+        for (size_t i = 0; i < padded; i += BATCH)
+        {
+            __m128 behind = zero;
+            for (int plane = 0; plane < 6; plane++)
+            {
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[plane][0], _mm_loadu_ps(corners[plane][0] + i)),
+                                                        _mm_mul_ps(planes[plane][1], _mm_loadu_ps(corners[plane][1] + i))),
+                                             _mm_add_ps(_mm_mul_ps(planes[plane][2], _mm_loadu_ps(corners[plane][2] + i)),
+                                                        planes[plane][3]));
+                behind = _mm_or_ps(behind, _mm_cmplt_ps(distance, zero));
+            }
+            int mask = _mm_movemask_ps(behind);
+            for (size_t lane = 0; lane < BATCH; lane++)
+                outside[i + lane] = (uint8_t)((mask >> lane) & 1);
+        }
+#else
+        for (size_t i = 0; i < padded; i++)
+            for (int plane = 0; plane < 6; plane++)
+            {
+                const glm::vec4 &normal = frustum.planes[plane];
+                outside[i] |= normal.x * corners[plane][0][i] + normal.y * corners[plane][1][i]
+                            + normal.z * corners[plane][2][i] + normal.w < 0.0f;
+            }
+#endif
+    }
+
+    bool visible(size_t box) const { return !outside[box]; }
+
+private:
+    static const size_t BATCH = 4;
+    enum Coordinate { MIN_X, MIN_Y, MIN_Z, MAX_X, MAX_Y, MAX_Z };
+
+    std::vector<float> bounds[6];
+    std::vector<uint8_t> outside;
+    size_t count = 0;
+};
+#endif
@@ -0,0 +1,125 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/mesh.h>
+
+#include <algorithm>
+#include <cstddef>
+
+// One vertex buffer and one index buffer holding the static geometry of several models, drawn through a single
+// vertex array.
+//
+// Models loaded with ModelOptions::arena append their SharedGeometry here instead of creating buffers of their own,
+// so every mesh of the same vertex format is reachable from one vertex array with base vertex and first index
+// alone. That is what lets the RenderQueue put all of them into one multi draw indirect call. The buffers grow by
+// doubling; growing copies the old contents on the GPU with glCopyBufferSubData. The GL objects are deleted by
+// release, which has to be called while the context is still current; the destructor leaves them alone.
+class GeometryArena {
+public:
+    explicit GeometryArena(VertexFormat format) : format(format)
+    {
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+    }
+
+    GeometryArena(const GeometryArena &) = delete;
+    GeometryArena &operator=(const GeometryArena &) = delete;
+
+    // deletes the buffers and the vertex array, the models drawing from the arena can no longer be drawn
+    void release()
+    {
+        if (!VAO)
+            return;
+        glDeleteBuffers(1, &EBO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteVertexArrays(1, &VAO);
+        VAO = VBO = EBO = 0;
+        vertexBytes = indexBytes = vertexCapacity = indexCapacity = 0;
+        vertexCount = 0;
+    }
+
+    // where appended geometry starts: the vertex its base vertices count from and the byte offset of its indices
+    struct Range {
+        GLint baseVertex;
+        size_t indexOffset;
+    };
+
+    // copies geometry of the arena's vertex format to the end of the buffers
+    Range append(const SharedGeometry &geometry)
+    {
+        // indices keep the alignment of the largest index type so the offsets inside geometry stay aligned
+        Range range = {vertexCount, (indexBytes + 3) / 4 * 4};
+        size_t vertexOffset = vertexBytes;
+        reserve(vertexOffset + geometry.vertexData.size(), range.indexOffset + geometry.indexData.size());
+
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferSubData(GL_ARRAY_BUFFER, vertexOffset, geometry.vertexData.size(), geometry.vertexData.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        GLState::instance().bindVertexArray(VAO);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, range.indexOffset, geometry.indexData.size(), geometry.indexData.data());
+        GLState::instance().bindVertexArray(0);
+
+        vertexBytes = vertexOffset + geometry.vertexData.size();
+        indexBytes = range.indexOffset + geometry.indexData.size();
+        vertexCount += geometry.vertexCount;
+        return range;
+    }
+
+    size_t vertexBytesUsed() const { return vertexBytes; }
+    size_t indexBytesUsed() const { return indexBytes; }
+
+    const VertexFormat format;
+    unsigned int VAO = 0;
+
+private:
+    unsigned int VBO = 0, EBO = 0;
+    size_t vertexBytes = 0, indexBytes = 0;
+    size_t vertexCapacity = 0, indexCapacity = 0;
+    GLint vertexCount = 0;
+
+    // grows the buffers to hold at least the given sizes, keeping their contents
+    void reserve(size_t vertices, size_t indices)
+    {
+        if (vertices > vertexCapacity)
+        {
+            vertexCapacity = grow(VBO, vertexBytes, std::max(vertices, vertexCapacity * 2));
+            // the attribute pointers of the vertex array still name the old buffer
+            GLState::instance().bindVertexArray(VAO);
+            glBindBuffer(GL_ARRAY_BUFFER, VBO);
+            Mesh::setupAttributes(format);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            GLState::instance().bindVertexArray(0);
+        }
+        if (indices > indexCapacity)
+        {
+            indexCapacity = grow(EBO, indexBytes, std::max(indices, indexCapacity * 2));
+            GLState::instance().bindVertexArray(VAO);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+            GLState::instance().bindVertexArray(0);
+        }
+    }
+
+    // replaces buffer by one of capacity bytes holding its first used bytes, returns the capacity
+    static size_t grow(unsigned int &buffer, size_t used, size_t capacity)
+    {
+        unsigned int grown;
+        glGenBuffers(1, &grown);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+        glBufferData(GL_COPY_WRITE_BUFFER, capacity, nullptr, GL_STATIC_DRAW);
+        if (used)
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glDeleteBuffers(1, &buffer);
+        buffer = grown;
+        return capacity;
+    }
+};
+#endif
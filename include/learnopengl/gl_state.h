@@ -0,0 +1,223 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+#include <vector>
+
+// state setting calls that reached the driver and the ones dropped because they would not have changed anything
+struct GLStateStats {
+    unsigned long long issued = 0;
+    unsigned long long elided = 0;
+};
+
+// Shadow of the GL state the renderer touches: the current program, the vertex array, the textures bound to each
+// unit, the framebuffers, enable bits, clear color and viewport.
+//
+// Every call is compared with the shadow and only sent to the driver when it changes the state, so drawing code
+// can state what it needs without unbinding after itself or checking what the previous draw left behind. This only
+// works as long as all code changes these states through the tracker; state that was never set through it is
+// unknown and the first call always goes through. Only to be used from the thread owning the GL context.
+class GLState {
+public:
+    static GLState &instance()
+    {
+        static GLState state;
+        return state;
+    }
+
+    void useProgram(GLuint program)
+    {
+        if (track(currentProgram, program))
+            glUseProgram(program);
+    }
+
+    void bindVertexArray(GLuint vertexArray)
+    {
+        if (track(currentVertexArray, vertexArray))
+            glBindVertexArray(vertexArray);
+    }
+
+    // selects the active texture unit (0 for GL_TEXTURE0)
+    void activeTexture(unsigned int unit)
+    {
+        if (track(activeUnit, unit))
+            glActiveTexture(GL_TEXTURE0 + unit);
+    }
+
+    // binds texture to target on the given unit and leaves the unit active. Texture data and parameter calls
+    // (glTexImage2D, glTexParameteri, glGenerateMipmap, ...) act on the texture of the active unit, use this before
+    // them rather than bindTexture, which does not select the unit when the texture is bound already.
+    void bindTextureForEdit(unsigned int unit, GLenum target, GLuint texture)
+    {
+        activeTexture(unit);
+        bindTexture(unit, target, texture);
+    }
+
+    // binds texture to target on the given unit (0 for GL_TEXTURE0), selecting the unit only if the binding changes
+    void bindTexture(unsigned int unit, GLenum target, GLuint texture)
+    {
+        GLuint *binding = textureBinding(unit, target);
+        if (binding && !track(*binding, texture))
+            return;
+        if (track(activeUnit, unit))
+            glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(target, texture);
+        if (!binding)
+            stats.issued++;
+    }
+
+    // deletes a texture, GL unbinds it from every unit it is bound to
+    void deleteTexture(GLuint texture)
+    {
+        glDeleteTextures(1, &texture);
+        for (TextureUnit &unit : units)
+        {
+            if (unit.texture2D == texture)
+                unit.texture2D = 0;
+            if (unit.texture2DMultisample == texture)
+                unit.texture2DMultisample = 0;
+        }
+    }
+
+    // GL_FRAMEBUFFER binds both the read and the draw framebuffer
+    void bindFramebuffer(GLenum target, GLuint framebuffer)
+    {
+        if (target == GL_FRAMEBUFFER)
+        {
+            if (readFramebuffer == framebuffer && drawFramebuffer == framebuffer)
+            {
+                stats.elided++;
+                return;
+            }
+            readFramebuffer = drawFramebuffer = framebuffer;
+            stats.issued++;
+            glBindFramebuffer(target, framebuffer);
+            return;
+        }
+        GLuint &binding = target == GL_READ_FRAMEBUFFER ? readFramebuffer : drawFramebuffer;
+        if (track(binding, framebuffer))
+            glBindFramebuffer(target, framebuffer);
+    }
+
+    void enable(GLenum capability) { setEnabled(capability, true); }
+    void disable(GLenum capability) { setEnabled(capability, false); }
+
+    void clearColor(float red, float green, float blue, float alpha)
+    {
+        float color[4] = {red, green, blue, alpha};
+        if (clearColorKnown && memcmp(color, currentClearColor, sizeof(color)) == 0)
+        {
+            stats.elided++;
+            return;
+        }
+        memcpy(currentClearColor, color, sizeof(color));
+        clearColorKnown = true;
+        stats.issued++;
+        glClearColor(red, green, blue, alpha);
+    }
+
+    void viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+    {
+        GLint rectangle[4] = {x, y, width, height};
+        if (viewportKnown && memcmp(rectangle, currentViewport, sizeof(rectangle)) == 0)
+        {
+            stats.elided++;
+            return;
+        }
+        memcpy(currentViewport, rectangle, sizeof(rectangle));
+        viewportKnown = true;
+        stats.issued++;
+        glViewport(x, y, width, height);
+    }
+
+    // calls of the frame so far
+    const GLStateStats &frame() const { return stats; }
+
+    // adds the calls of the frame to the totals and starts counting the next one
+    void endFrame()
+    {
+        totalStats.issued += stats.issued;
+        totalStats.elided += stats.elided;
+        stats = GLStateStats();
+        frames++;
+    }
+
+    const GLStateStats &totals() const { return totalStats; }
+    unsigned long long frameCount() const { return frames; }
+
+private:
+    static const GLuint UNKNOWN = ~0u;
+
+    struct TextureUnit {
+        GLuint texture2D = UNKNOWN;
+        GLuint texture2DMultisample = UNKNOWN;
+    };
+
+    struct Capability {
+        GLenum capability;
+        bool enabled;
+    };
+
+    GLuint currentProgram = UNKNOWN;
+    GLuint currentVertexArray = UNKNOWN;
+    GLuint activeUnit = UNKNOWN;
+    std::vector<TextureUnit> units;
+    GLuint readFramebuffer = UNKNOWN;
+    GLuint drawFramebuffer = UNKNOWN;
+    std::vector<Capability> capabilities;
+    float currentClearColor[4] = {};
+    bool clearColorKnown = false;
+    GLint currentViewport[4] = {};
+    bool viewportKnown = false;
+    GLStateStats stats;
+    GLStateStats totalStats;
+    unsigned long long frames = 0;
+
+    GLState() = default;
+
+    // stores value in the shadow, returns whether the call is needed
+    bool track(GLuint &shadow, GLuint value)
+    {
+        if (shadow == value)
+        {
+            stats.elided++;
+            return false;
+        }
+        shadow = value;
+        stats.issued++;
+        return true;
+    }
+
+    // shadow of a texture binding, nullptr for targets that are not tracked
+    GLuint *textureBinding(unsigned int unit, GLenum target)
+    {
+        if (target != GL_TEXTURE_2D && target != GL_TEXTURE_2D_MULTISAMPLE)
+            return nullptr;
+        if (unit >= units.size())
+            units.resize(unit + 1);
+        return target == GL_TEXTURE_2D ? &units[unit].texture2D : &units[unit].texture2DMultisample;
+    }
+
+    void setEnabled(GLenum capability, bool enabled)
+    {
+        for (Capability &known : capabilities)
+            if (known.capability == capability)
+            {
+                if (known.enabled == enabled)
+                {
+                    stats.elided++;
+                    return;
+                }
+                known.enabled = enabled;
+                stats.issued++;
+                enabled ? glEnable(capability) : glDisable(capability);
+                return;
+            }
+        capabilities.push_back({capability, enabled});
+        stats.issued++;
+        enabled ? glEnable(capability) : glDisable(capability);
+    }
+};
+#endif
@@ -0,0 +1,64 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+
+// GPU time spent on a span of commands, measured with GL_TIME_ELAPSED queries (core since GL 3.3).
+//
+// Every begin/end pair uses the next of a small ring of queries and the results are collected when a query
+// comes round again, several frames later, so measuring does not make the CPU wait for the GPU. Spans must not
+// nest, GL allows one GL_TIME_ELAPSED query at a time.
+class GpuTimer {
+public:
+    GpuTimer() { glGenQueries(LATENCY, queries); }
+
+    GpuTimer(const GpuTimer &) = delete;
+    GpuTimer &operator=(const GpuTimer &) = delete;
+
+    void begin()
+    {
+        collect(next);
+        glBeginQuery(GL_TIME_ELAPSED, queries[next]);
+    }
+
+    void end()
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        pending[next] = true;
+        next = (next + 1) % LATENCY;
+    }
+
+    // average over the spans measured so far, including the ones still in flight
+    double averageMilliseconds()
+    {
+        for (unsigned int i = 0; i < LATENCY; i++)
+            collect(i);
+        return samples ? (double)total / samples * 1e-6 : 0.0;
+    }
+
+    uint64_t sampleCount() const { return samples; }
+
+private:
+    static const unsigned int LATENCY = 4;
+
+    GLuint queries[LATENCY];
+    bool pending[LATENCY] = {};
+    unsigned int next = 0;
+    uint64_t total = 0;
+    uint64_t samples = 0;
+
+    // waits only if the GPU is more than LATENCY spans behind
+    void collect(unsigned int query)
+    {
+        if (!pending[query])
+            return;
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(queries[query], GL_QUERY_RESULT, &elapsed);
+        total += elapsed;
+        samples++;
+        pending[query] = false;
+    }
+};
+#endif
@@ -5,10 +5,19 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
 
+#include <learnopengl/gl_state.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/render_queue.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
 #include <string>
+#include <utility>
 #include <vector>
 using namespace std;
 
@@ -25,7 +34,28 @@ struct Vertex {
     glm::vec3 Bitangent;
 };
 
+// compact vertex layout used by VertexFormat::Packed, 20 bytes instead of the 56 of Vertex:
+// positions are 16 bit normalized relative to the mesh bounds (dequantized in the vertex shader through the
+// positionScale/positionOffset uniforms), normal and tangent are 10_10_10_2 signed normalized with the tangent
+// handedness stored in w (the bitangent is rebuilt as cross(normal, tangent) * w), texture coordinates are half floats.
+struct PackedVertex {
+    int16_t  Position[4];
+    uint32_t Normal;
+    uint32_t Tangent;
+    uint16_t TexCoords[2];
+};
 
+enum class VertexFormat {
+    Full,   // Vertex as imported, all attributes as floats
+    Packed  // PackedVertex
+};
+
+// what a Mesh keeps in system memory once its buffers are uploaded
+enum class GeometryResidency {
+    Keep,           // vertices and indices, as before the upload
+    PositionsOnly,  // positions (Mesh::positions) and indices, enough for picking and collision
+    Drop            // nothing, the geometry only lives in the GL buffers
+};
 
 struct Texture {
     unsigned int id;
@@ -33,37 +63,295 @@ struct Texture {
     string path;
 };
 
+// texture file used by a mesh, the path is relative to the model directory
+struct TextureReference {
+    string type;
+    string path;
+};
+
+// coarser level of detail of a mesh, indexes the vertices of the full mesh
+struct MeshLod {
+    vector<unsigned int> indices;
+    float                error;  // largest distance from the full mesh surface, in model units
+};
+
+// CPU side mesh produced by the importer on any thread, turned into a Mesh on the thread owning the GL context
+struct MeshData {
+    vector<Vertex>           vertices;
+    vector<unsigned int>     indices;
+    vector<TextureReference> textures;
+    AABB                     bounds;
+    vector<MeshLod>          lods;  // coarser levels, in order of decreasing detail
+};
+
+// vertex and index data of several meshes packed back to back, uploaded into a single VBO/EBO pair so they can
+// share one VAO (see Model). All meshes in it use the same vertex format.
+struct SharedGeometry {
+    VertexFormat          format = VertexFormat::Full;
+    vector<unsigned char> vertexData;
+    vector<unsigned char> indexData;
+    GLint                 vertexCount = 0;
+};
+
 class Mesh {
 public:
     // mesh Data
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
+    vector<glm::vec3>    positions;  // only filled in with GeometryResidency::PositionsOnly
+    vector<MeshLod>      lods;
+    AABB                 bounds;
+    VertexFormat         format;
 
     unsigned int VAO;
     std::string glslIdentifierPrefix;
     // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    Mesh(const vector<Vertex> &vertices, const vector<unsigned int> &indices, const vector<Texture> &textures)
+        : Mesh(vertices, indices, textures, computeBounds(vertices))
+    {
+    }
+
+    // constructor for meshes whose bounds are already known (e.g. read back from the mesh cache)
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, AABB bounds,
+         VertexFormat format = VertexFormat::Full)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        this->vertices = std::move(vertices);
+        this->indices = std::move(indices);
+        this->textures = std::move(textures);
+        this->bounds = bounds;
+        this->format = format;
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
         setupMesh();
     }
 
-    // render the mesh
+    // constructor for a submesh of shared buffers: only appends the geometry (and its levels of detail) to shared,
+    // the GL objects are created for all submeshes at once by uploadShared
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, AABB bounds,
+         SharedGeometry &shared, vector<MeshLod> lods = vector<MeshLod>())
+    {
+        this->vertices = std::move(vertices);
+        this->indices = std::move(indices);
+        this->textures = std::move(textures);
+        this->lods = std::move(lods);
+        this->bounds = bounds;
+        this->format = shared.format;
+        this->VAO = 0;
+
+        baseVertex = shared.vertexCount;
+        shared.vertexCount += (GLint)this->vertices.size();
+        appendVertices(shared.vertexData);
+        appendIndices(shared.indexData);
+    }
+
+    // creates the buffers and the vertex array of shared geometry, returns the VAO the submeshes are drawn with
+    static unsigned int uploadShared(const SharedGeometry &shared, unsigned int &VBO, unsigned int &EBO)
+    {
+        unsigned int VAO;
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+
+        GLState::instance().bindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, shared.vertexData.size(), shared.vertexData.data(), GL_STATIC_DRAW);
+        setupAttributes(shared.format);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, shared.indexData.size(), shared.indexData.data(), GL_STATIC_DRAW);
+        GLState::instance().bindVertexArray(0);
+        return VAO;
+    }
+
+    // sets the vertex attribute pointers for the vertex buffer bound to GL_ARRAY_BUFFER
+    static void setupAttributes(VertexFormat format)
+    {
+        if (format == VertexFormat::Packed)
+        {
+            // vertex Positions
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Position));
+            // vertex normals, packed formats always have 4 components, the shader only reads xyz
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Normal));
+            // vertex texture coords
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, TexCoords));
+            // vertex tangent with handedness in w
+            glEnableVertexAttribArray(3);
+            glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Tangent));
+            // no bitangent, attribute 4 keeps its default value
+            return;
+        }
+
+        // set the vertex attribute pointers
+        // vertex Positions
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+        // vertex normals
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+        // vertex texture coords
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+        // vertex tangent
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+        // vertex bitangent
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+    }
+
+    // moves the mesh to where its shared geometry was copied, e.g. into a GeometryArena: vertexOffset vertices
+    // and indexOffset bytes further into the buffers
+    void relocate(GLint vertexOffset, size_t indexOffset)
+    {
+        baseVertex += vertexOffset;
+        for (LodRange &range : lodRanges)
+            range.indexOffset += indexOffset;
+    }
+
+    static AABB computeBounds(const vector<Vertex> &vertices)
+    {
+        AABB box;
+        box.min = glm::vec3(vertices.empty() ? 0.0f : std::numeric_limits<float>::max());
+        box.max = glm::vec3(vertices.empty() ? 0.0f : -std::numeric_limits<float>::max());
+        for (const Vertex &vertex : vertices)
+        {
+            box.min = glm::min(box.min, vertex.Position);
+            box.max = glm::max(box.max, vertex.Position);
+        }
+        return box;
+    }
+
+    // system memory held by the geometry copies of the mesh
+    size_t geometryBytes() const
+    {
+        size_t bytes = vertices.capacity() * sizeof(Vertex) + indices.capacity() * sizeof(unsigned int)
+                     + positions.capacity() * sizeof(glm::vec3);
+        for (const MeshLod &lod : lods)
+            bytes += lod.indices.capacity() * sizeof(unsigned int);
+        return bytes;
+    }
+
+    // frees the geometry copies not needed by the given policy, returns the number of bytes given back.
+    // drawing only needs the GL buffers, the textures stay since they hold the texture ids.
+    size_t applyResidency(GeometryResidency residency)
+    {
+        size_t before = geometryBytes();
+        if (residency == GeometryResidency::PositionsOnly && !vertices.empty())
+        {
+            vector<glm::vec3> kept(vertices.size());
+            for (size_t i = 0; i < vertices.size(); i++)
+                kept[i] = vertices[i].Position;
+            positions.swap(kept);
+        }
+        if (residency != GeometryResidency::Keep)
+        {
+            vector<Vertex>().swap(vertices);
+            vector<MeshLod>().swap(lods);
+        }
+        if (residency == GeometryResidency::Drop)
+        {
+            vector<unsigned int>().swap(indices);
+            vector<glm::vec3>().swap(positions);
+        }
+        size_t after = geometryBytes();
+        return before > after ? before - after : 0;
+    }
+
+    // number of levels of detail including the full mesh (level 0)
+    unsigned int lodCount() const { return (unsigned int)lodRanges.size(); }
+
+    // picks the level to draw when one model unit at the mesh covers pixelsPerUnit pixels on screen: the coarsest
+    // level whose error stays below threshold pixels. Going coarser than the current level additionally needs the
+    // error to drop below threshold * (1 - hysteresis), so a mesh near a switching distance does not flicker.
+    unsigned int selectLod(float pixelsPerUnit, unsigned int current, float threshold = 1.0f, float hysteresis = 0.25f) const
+    {
+        if (current >= lodCount())
+            current = 0;
+        unsigned int finer = 0, coarser = 0;
+        for (unsigned int level = 1; level < lodCount(); level++)
+        {
+            float error = lodRanges[level].error * pixelsPerUnit;
+            if (error <= threshold)
+                finer = level;
+            if (error <= threshold * (1.0f - hysteresis))
+                coarser = level;
+        }
+        if (current > finer)
+            return finer;
+        return std::max(current, coarser);
+    }
+
+    // render the mesh. The vertex array and textures stay bound, the next draw only changes what it needs
+    // (see GLState)
     void Draw(Shader &shader)
     {
+        GLState::instance().bindVertexArray(VAO);
+        DrawBound(shader);
+    }
+
+    // submits the mesh to a render queue, item brings the pass, program and transform
+    void Draw(RenderQueue &queue, DrawItem item, unsigned int lod = 0)
+    {
+        const LodRange &range = lodRanges[std::min(lod, lodCount() - 1)];
+        item.vao = VAO;
+        item.material = &material();
+        item.indexType = indexType;
+        item.count = range.indexCount;
+        item.first = range.indexOffset;
+        item.baseVertex = baseVertex;
+        item.positionScale = positionScale;
+        item.positionOffset = positionOffset;
+        AABB worldBounds = item.transform ? transformBounds(bounds, item.transform->model()) : bounds;
+        queue.submit(item, (worldBounds.min + worldBounds.max) * 0.5f, worldBounds);
+    }
+
+    // render the mesh with its vertex array already bound, used by Model to draw all submeshes of its
+    // shared buffers with a single bind
+    void DrawBound(Shader &shader, unsigned int lod = 0)
+    {
+        // the uniform handles of the program, looked up on its first draw
+        DrawUniforms &drawUniforms = DrawUniforms::instance();
+        DrawUniforms::Program &uniforms = drawUniforms.program(shader);
         // bind appropriate textures
+        const Material &bindings = material();
+        const std::vector<UniformHandle> &samplers = drawUniforms.samplers(shader, uniforms, bindings);
+        for(unsigned int i = 0; i < bindings.textures.size(); i++)
+        {
+            // set the sampler to the correct texture unit
+            if (!bindings.samplers[i].empty())
+                shader.setInt(samplers[i], i);
+            // and bind the texture to it, GLState selects the unit only when the binding changes
+            GLState::instance().bindTexture(i, GL_TEXTURE_2D, bindings.textures[i]);
+        }
+
+
+
+        // dequantization of packed positions, identity for full float vertices
+        shader.setVec3(uniforms.positionScale, positionScale);
+        shader.setVec3(uniforms.positionOffset, positionOffset);
+
+        // draw mesh, the indices are relative to the first vertex of the mesh in the vertex buffer
+        const LodRange &range = lodRanges[std::min(lod, lodCount() - 1)];
+        glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, indexType, (void*)range.indexOffset, baseVertex);
+    }
+
+    // the textures with their sampler names (glslIdentifierPrefix + type + number, e.g. material.texture_diffuse1),
+    // named again when the prefix changed. Meshes with the same textures get the same Material (see
+    // MaterialRegistry), so the RenderQueue can batch them.
+    const Material &material()
+    {
+        if (textureBindings && materialPrefix == glslIdentifierPrefix)
+            return *textureBindings;
+        Material bindings;
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr   = 1;
         unsigned int heightNr   = 1;
         for(unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // retrieve texture number (the N in diffuse_textureN)
             string number;
             string name = textures[i].type;
@@ -75,65 +363,126 @@ public:
                 number = std::to_string(normalNr++); // transfer unsigned int to stream
             else if(name == "texture_height")
                 number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            bindings.textures.push_back(textures[i].id);
+            bindings.samplers.push_back(glslIdentifierPrefix + name + number);
         }
-
-
-
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+        materialPrefix = glslIdentifierPrefix;
+        textureBindings = MaterialRegistry::instance().intern(bindings);
+        return *textureBindings;
     }
 
 private:
-    // render data
-    unsigned int VBO, EBO;
+    // indices of one level of detail in the index buffer
+    struct LodRange {
+        GLsizei indexCount;
+        size_t  indexOffset;  // in bytes
+        float   error;
+    };
+
+    // render data, VBO and EBO stay 0 for submeshes of shared buffers
+    unsigned int VBO = 0, EBO = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+    vector<LodRange> lodRanges;
+    GLint baseVertex = 0;
+    glm::vec3 positionScale = glm::vec3(1.0f);
+    glm::vec3 positionOffset = glm::vec3(0.0f);
+    const Material *textureBindings = nullptr;
+    std::string materialPrefix;
 
     // initializes all the buffer objects/arrays
     void setupMesh()
     {
+        vector<unsigned char> vertexData, indexData;
+        appendVertices(vertexData);
+        appendIndices(indexData);
+
         // create buffers/arrays
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
 
-        glBindVertexArray(VAO);
+        GLState::instance().bindVertexArray(VAO);
         // load data into vertex buffers
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, vertexData.size(), vertexData.data(), GL_STATIC_DRAW);
+        setupAttributes(format);
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexData.size(), indexData.data(), GL_STATIC_DRAW);
 
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+        GLState::instance().bindVertexArray(0);
+    }
 
-        glBindVertexArray(0);
+    // appends the vertices in the mesh's format
+    void appendVertices(vector<unsigned char> &data)
+    {
+        if (format == VertexFormat::Packed)
+        {
+            vector<PackedVertex> packed = packVertices();
+            append(data, packed.data(), packed.size() * sizeof(PackedVertex));
+        }
+        else
+        {
+            // A great thing about structs is that their memory layout is sequential for all its items.
+            // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
+            // again translates to 3/2 floats which translates to a byte array.
+            append(data, vertices.data(), vertices.size() * sizeof(Vertex));
+        }
+    }
+
+    // appends the indices of every level of detail with the smallest type able to address every vertex of the mesh,
+    // half the size for the usual mesh with at most 65536 vertices
+    void appendIndices(vector<unsigned char> &data)
+    {
+        indexType = vertices.size() <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        lodRanges.clear();
+        lodRanges.push_back({(GLsizei)indices.size(), appendIndices(data, indices), 0.0f});
+        for (const MeshLod &lod : lods)
+            lodRanges.push_back({(GLsizei)lod.indices.size(), appendIndices(data, lod.indices), lod.error});
+    }
+
+    // returns the byte offset of the first index
+    size_t appendIndices(vector<unsigned char> &data, const vector<unsigned int> &source) const
+    {
+        if (indexType == GL_UNSIGNED_SHORT)
+        {
+            vector<uint16_t> shortIndices(source.begin(), source.end());
+            return append(data, shortIndices.data(), shortIndices.size() * sizeof(uint16_t), sizeof(uint16_t));
+        }
+        return append(data, source.data(), source.size() * sizeof(unsigned int), sizeof(unsigned int));
+    }
+
+    // appends size bytes at the next multiple of alignment, returns where they start
+    static size_t append(vector<unsigned char> &data, const void *bytes, size_t size, size_t alignment = 1)
+    {
+        size_t offset = (data.size() + alignment - 1) / alignment * alignment;
+        data.resize(offset + size);
+        if (size)
+            memcpy(&data[offset], bytes, size);
+        return offset;
+    }
+
+    vector<PackedVertex> packVertices()
+    {
+        // positions are stored relative to the center of the bounds, scaled by their half extent
+        positionOffset = (bounds.min + bounds.max) * 0.5f;
+        positionScale = glm::max((bounds.max - bounds.min) * 0.5f, glm::vec3(1e-6f));
+
+        vector<PackedVertex> packed(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            const Vertex &vertex = vertices[i];
+            glm::vec3 position = glm::clamp((vertex.Position - positionOffset) / positionScale, -1.0f, 1.0f);
+            for (int c = 0; c < 3; c++)
+                packed[i].Position[c] = (int16_t)std::lround(position[c] * 32767.0f);
+            packed[i].Position[3] = 0;
+            float handedness = glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) < 0.0f ? -1.0f : 1.0f;
+            packed[i].Normal = glm::packSnorm3x10_1x2(glm::vec4(vertex.Normal, 0.0f));
+            packed[i].Tangent = glm::packSnorm3x10_1x2(glm::vec4(vertex.Tangent, handedness));
+            packed[i].TexCoords[0] = glm::packHalf1x16(vertex.TexCoords.x);
+            packed[i].TexCoords[1] = glm::packHalf1x16(vertex.TexCoords.y);
+        }
+        return packed;
     }
 };
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,349 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <learnopengl/hash.h>
+#include <learnopengl/mesh.h>
+
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// On-disk cache of imported model geometry.
+//
+// Every model file gets one cache file in MESH_CACHE_DIRECTORY. The file name is derived from the source
+// file name and a key combining the hash of the source file contents, the material libraries an .obj references
+// (mtllib), the Assimp import flags and whether levels of detail are generated, so editing the model or its
+// materials or changing the import pipeline simply produces a new cache entry. The layout is:
+//
+//   MeshCacheHeader
+//   for every mesh: MeshCacheRecord, vertices, indices, levels of detail, texture references (all 4 byte aligned)
+//   for every level of detail: index count, error, indices
+//
+// Bump MESH_CACHE_VERSION whenever the layout, the Vertex struct or the import stages change.
+
+#define MESH_CACHE_DIRECTORY "resources/cache"
+#define MESH_CACHE_VERSION 4u
+
+static const char MESH_CACHE_MAGIC[4] = {'T', 'P', 'M', 'C'};
+
+struct MeshCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint32_t vertexSize;
+    uint32_t meshCount;
+};
+
+struct MeshCacheRecord {
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t textureCount;
+    uint32_t lodCount;
+    float boundsMin[3];
+    float boundsMax[3];
+};
+
+// texture reference of a cached mesh, strings point into the mapped file and are not null terminated
+struct MeshCacheTexture {
+    const char *type;
+    uint32_t typeLength;
+    const char *path;
+    uint32_t pathLength;
+};
+
+// level of detail of a cached mesh
+struct MeshCacheLod {
+    const unsigned int *indices;
+    uint32_t indexCount;
+    float error;
+};
+
+// view of a single mesh inside a mapped cache file
+struct MeshCacheEntry {
+    const Vertex *vertices;
+    uint32_t vertexCount;
+    const unsigned int *indices;
+    uint32_t indexCount;
+    vector<MeshCacheLod> lods;
+    vector<MeshCacheTexture> textures;
+    AABB bounds;
+};
+
+// read only memory mapping of a file, unmapped when it goes out of scope
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const string &path)
+    {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0)
+        {
+            void *mapping = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED)
+            {
+                bytes = static_cast<const unsigned char *>(mapping);
+                length = (size_t)info.st_size;
+            }
+        }
+        ::close(fd);
+        return bytes != nullptr;
+    }
+
+    void close()
+    {
+        if (bytes)
+            munmap(const_cast<unsigned char *>(bytes), length);
+        bytes = nullptr;
+        length = 0;
+    }
+
+    const unsigned char *data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const unsigned char *bytes = nullptr;
+    size_t length = 0;
+};
+
+class MeshCache {
+public:
+    // hashes the source model, a cache entry is only usable when the source could be read. Entries with and
+    // without levels of detail are kept apart.
+    MeshCache(const string &sourcePath, unsigned int importFlags, bool levelsOfDetail = true)
+    {
+        MappedFile source;
+        if (!source.open(sourcePath))
+            return;
+        key = fnv1a64(source.data(), source.size());
+        // texture paths and material assignment come from the .mtl files, they are cached with the meshes
+        string directory = sourcePath.substr(0, sourcePath.find_last_of('/') + 1);
+        for (const string &library : materialLibraries(source))
+        {
+            key = fnv1a64(library.data(), library.size(), key);
+            MappedFile material;
+            if (material.open(directory + library))
+                key = fnv1a64(material.data(), material.size(), key);
+        }
+        key = fnv1a64(&importFlags, sizeof(importFlags), key);
+        uint8_t lods = levelsOfDetail ? 1 : 0;
+        key = fnv1a64(&lods, sizeof(lods), key);
+        uint32_t version = MESH_CACHE_VERSION;
+        key = fnv1a64(&version, sizeof(version), key);
+
+        string name = sourcePath.substr(sourcePath.find_last_of('/') + 1);
+        char suffix[32];
+        snprintf(suffix, sizeof(suffix), "-%016llx.meshcache", (unsigned long long)key);
+        cachePath = string(MESH_CACHE_DIRECTORY) + '/' + name + suffix;
+    }
+
+    bool valid() const { return !cachePath.empty(); }
+
+    // maps the cache entry and fills in views of all meshes, the views stay valid as long as this object lives
+    bool load(vector<MeshCacheEntry> &entries)
+    {
+        entries.clear();
+        if (!valid() || !file.open(cachePath))
+            return false;
+
+        size_t offset = 0;
+        const MeshCacheHeader *header = read<MeshCacheHeader>(offset);
+        if (!header || memcmp(header->magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) != 0
+            || header->version != MESH_CACHE_VERSION || header->key != key || header->vertexSize != sizeof(Vertex))
+            return fail(entries);
+
+        for (uint32_t i = 0; i < header->meshCount; i++)
+        {
+            const MeshCacheRecord *record = read<MeshCacheRecord>(offset);
+            if (!record)
+                return fail(entries);
+            MeshCacheEntry entry;
+            entry.vertexCount = record->vertexCount;
+            entry.indexCount = record->indexCount;
+            entry.bounds.min = glm::vec3(record->boundsMin[0], record->boundsMin[1], record->boundsMin[2]);
+            entry.bounds.max = glm::vec3(record->boundsMax[0], record->boundsMax[1], record->boundsMax[2]);
+            entry.vertices = read<Vertex>(offset, record->vertexCount);
+            entry.indices = read<unsigned int>(offset, record->indexCount);
+            if ((record->vertexCount && !entry.vertices) || (record->indexCount && !entry.indices))
+                return fail(entries);
+            for (uint32_t l = 0; l < record->lodCount; l++)
+            {
+                const uint32_t *indexCount = read<uint32_t>(offset);
+                const float *error = read<float>(offset);
+                if (!indexCount || !error)
+                    return fail(entries);
+                MeshCacheLod lod;
+                lod.indexCount = *indexCount;
+                lod.error = *error;
+                lod.indices = read<unsigned int>(offset, lod.indexCount);
+                if (lod.indexCount && !lod.indices)
+                    return fail(entries);
+                entry.lods.push_back(lod);
+            }
+            for (uint32_t t = 0; t < record->textureCount; t++)
+            {
+                const uint32_t *lengths = read<uint32_t>(offset, 2);
+                if (!lengths)
+                    return fail(entries);
+                MeshCacheTexture texture;
+                texture.typeLength = lengths[0];
+                texture.pathLength = lengths[1];
+                texture.type = read<char>(offset, texture.typeLength);
+                texture.path = read<char>(offset, texture.pathLength);
+                if (!texture.type || !texture.path)
+                    return fail(entries);
+                entry.textures.push_back(texture);
+            }
+            entries.push_back(std::move(entry));
+        }
+        return true;
+    }
+
+    // writes the meshes of a freshly imported model, the file is written aside and renamed so a crash
+    // or a concurrent reader never sees a half written entry
+    bool store(const vector<MeshData> &meshes) const
+    {
+        if (!valid())
+            return false;
+        mkdir(MESH_CACHE_DIRECTORY, 0755);
+
+        string tempPath = cachePath + ".tmp";
+        FILE *out = fopen(tempPath.c_str(), "wb");
+        if (!out)
+        {
+            std::cout << "ERROR::MESH_CACHE:: could not write " << tempPath << std::endl;
+            return false;
+        }
+
+        MeshCacheHeader header;
+        memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+        header.version = MESH_CACHE_VERSION;
+        header.key = key;
+        header.vertexSize = sizeof(Vertex);
+        header.meshCount = (uint32_t)meshes.size();
+        bool ok = write(out, &header, sizeof(header));
+
+        for (const MeshData &mesh : meshes)
+        {
+            MeshCacheRecord record;
+            record.vertexCount = (uint32_t)mesh.vertices.size();
+            record.indexCount = (uint32_t)mesh.indices.size();
+            record.textureCount = (uint32_t)mesh.textures.size();
+            record.lodCount = (uint32_t)mesh.lods.size();
+            for (int c = 0; c < 3; c++)
+            {
+                record.boundsMin[c] = mesh.bounds.min[c];
+                record.boundsMax[c] = mesh.bounds.max[c];
+            }
+            ok = ok && write(out, &record, sizeof(record));
+            ok = ok && write(out, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+            ok = ok && write(out, mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+            for (const MeshLod &lod : mesh.lods)
+            {
+                uint32_t indexCount = (uint32_t)lod.indices.size();
+                ok = ok && write(out, &indexCount, sizeof(indexCount));
+                ok = ok && write(out, &lod.error, sizeof(lod.error));
+                ok = ok && write(out, lod.indices.data(), lod.indices.size() * sizeof(unsigned int));
+            }
+            for (const TextureReference &texture : mesh.textures)
+            {
+                uint32_t lengths[2] = {(uint32_t)texture.type.size(), (uint32_t)texture.path.size()};
+                ok = ok && write(out, lengths, sizeof(lengths));
+                ok = ok && write(out, texture.type.data(), texture.type.size());
+                ok = ok && write(out, texture.path.data(), texture.path.size());
+            }
+        }
+
+        ok = (fclose(out) == 0) && ok;
+        if (!ok || rename(tempPath.c_str(), cachePath.c_str()) != 0)
+        {
+            std::cout << "ERROR::MESH_CACHE:: could not write " << cachePath << std::endl;
+            remove(tempPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    uint64_t key = 0;
+    string cachePath;
+    MappedFile file;
+
+    static size_t align(size_t size) { return (size + 3) & ~size_t(3); }
+
+    // the files named by the mtllib lines of an .obj, relative to its directory. Like Assimp, the rest of the line
+    // is taken as one file name.
+    static vector<string> materialLibraries(const MappedFile &source)
+    {
+        static const char keyword[] = "mtllib";
+        const size_t keywordLength = sizeof(keyword) - 1;
+        vector<string> libraries;
+        const char *text = reinterpret_cast<const char *>(source.data());
+        size_t size = source.size();
+        for (size_t line = 0; line < size;)
+        {
+            size_t end = line;
+            while (end < size && text[end] != '\n')
+                end++;
+            if (end - line > keywordLength && memcmp(text + line, keyword, keywordLength) == 0
+                && (text[line + keywordLength] == ' ' || text[line + keywordLength] == '\t'))
+            {
+                size_t first = line + keywordLength, last = end;
+                while (first < last && isspace((unsigned char)text[first]))
+                    first++;
+                while (last > first && isspace((unsigned char)text[last - 1]))
+                    last--;
+                if (first < last)
+                    libraries.push_back(string(text + first, last - first));
+            }
+            line = end + 1;
+        }
+        return libraries;
+    }
+
+    // returns a pointer to count elements of T at offset and advances past them (keeping 4 byte alignment)
+    template<typename T>
+    const T *read(size_t &offset, size_t count = 1) const
+    {
+        size_t size = count * sizeof(T);
+        if (offset + size > file.size())
+            return nullptr;
+        const T *result = reinterpret_cast<const T *>(file.data() + offset);
+        offset = align(offset + size);
+        return result;
+    }
+
+    static bool write(FILE *out, const void *data, size_t size)
+    {
+        static const char padding[4] = {0, 0, 0, 0};
+        if (size && fwrite(data, 1, size, out) != size)
+            return false;
+        size_t pad = align(size) - size;
+        return pad == 0 || fwrite(padding, 1, pad, out) == pad;
+    }
+
+    bool fail(vector<MeshCacheEntry> &entries)
+    {
+        std::cout << "ERROR::MESH_CACHE:: ignoring invalid cache file " << cachePath << std::endl;
+        entries.clear();
+        file.close();
+        return false;
+    }
+};
+#endif
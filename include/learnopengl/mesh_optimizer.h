@@ -0,0 +1,396 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <learnopengl/mesh.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <iostream>
+
+// Import time optimization of triangle meshes for the GPU:
+//  1. weldVertices merges bitwise identical vertices (the OBJ importer emits one vertex per face corner)
+//  2. optimizeVertexCache reorders triangles for the post-transform vertex cache (Forsyth's linear speed algorithm)
+//  3. optimizeOverdraw reorders clusters of triangles front to back as seen from outside the mesh
+//     without giving up more than a few percent of the cache efficiency (after Sander et al., "Fast triangle reordering")
+//  4. optimizeVertexFetch reorders the vertices in the order they are first used
+//  5. splitMesh cuts meshes with more vertices than 16 bit indices can address into submeshes
+// analyzeVertexCache measures the result as ACMR (cache misses per triangle) and ATVR (misses per vertex).
+
+struct VertexCacheStatistics {
+    float acmr;
+    float atvr;
+};
+
+// simulates a FIFO post-transform cache of the given size
+inline VertexCacheStatistics analyzeVertexCache(const vector<unsigned int> &indices, size_t vertexCount, unsigned int cacheSize = 16)
+{
+    vector<unsigned int> timestamps(vertexCount, 0);
+    unsigned int time = cacheSize + 1;
+    unsigned int misses = 0;
+    for (unsigned int index : indices)
+    {
+        if (time - timestamps[index] > cacheSize)
+        {
+            timestamps[index] = time++;
+            misses++;
+        }
+    }
+    VertexCacheStatistics statistics;
+    statistics.acmr = indices.empty() ? 0.0f : float(misses) / float(indices.size() / 3);
+    statistics.atvr = vertexCount == 0 ? 0.0f : float(misses) / float(vertexCount);
+    return statistics;
+}
+
+struct VertexHash {
+    size_t operator()(const Vertex &vertex) const
+    {
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&vertex);
+        size_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < sizeof(Vertex); i++)
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        return hash;
+    }
+};
+
+struct VertexEqual {
+    bool operator()(const Vertex &a, const Vertex &b) const { return memcmp(&a, &b, sizeof(Vertex)) == 0; }
+};
+
+inline void weldVertices(vector<Vertex> &vertices, vector<unsigned int> &indices)
+{
+    std::unordered_map<Vertex, unsigned int, VertexHash, VertexEqual> unique;
+    unique.reserve(vertices.size());
+    vector<unsigned int> remap(vertices.size());
+    vector<Vertex> welded;
+    welded.reserve(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        auto inserted = unique.emplace(vertices[i], (unsigned int)welded.size());
+        if (inserted.second)
+            welded.push_back(vertices[i]);
+        remap[i] = inserted.first->second;
+    }
+    for (unsigned int &index : indices)
+        index = remap[index];
+    vertices.swap(welded);
+}
+
+inline void optimizeVertexCache(vector<unsigned int> &indices, size_t vertexCount)
+{
+    const int cacheSize = 32;
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // triangles adjacent to every vertex, the first liveTriangles entries of a vertex are not emitted yet
+    vector<unsigned int> liveTriangles(vertexCount, 0);
+    for (unsigned int index : indices)
+        liveTriangles[index]++;
+    vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+    vector<unsigned int> adjacency(indices.size());
+    vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++)
+        adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+    auto vertexScore = [](int cachePosition, unsigned int live) {
+        if (live == 0)
+            return -1.0f;
+        float score = 0.0f;
+        if (cachePosition >= 0)
+            score = cachePosition < 3 ? 0.75f : std::pow(1.0f - float(cachePosition - 3) / float(cacheSize - 3), 1.5f);
+        return score + 2.0f / std::sqrt(float(live));
+    };
+
+    vector<int> cachePositions(vertexCount, -1);
+    vector<float> vertexScores(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        vertexScores[v] = vertexScore(-1, liveTriangles[v]);
+    vector<float> triangleScores(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++)
+        triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+
+    vector<bool> emitted(triangleCount, false);
+    vector<unsigned int> result;
+    result.reserve(indices.size());
+    vector<unsigned int> cache, nextCache;
+    size_t inputCursor = 0;
+    long best = 0;
+
+    while (best >= 0)
+    {
+        emitted[best] = true;
+        const unsigned int *triangle = &indices[best * 3];
+        result.insert(result.end(), triangle, triangle + 3);
+
+        // the emitted vertices move to the front of the cache, the rest shifts back
+        nextCache.assign(triangle, triangle + 3);
+        for (unsigned int v : cache)
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                nextCache.push_back(v);
+        for (int c = 0; c < 3; c++)
+        {
+            unsigned int v = triangle[c];
+            unsigned int *begin = &adjacency[adjacencyOffsets[v]];
+            unsigned int *end = begin + liveTriangles[v];
+            unsigned int *found = std::find(begin, end, (unsigned int)best);
+            if (found != end)
+            {
+                std::swap(*found, *(end - 1));
+                liveTriangles[v]--;
+            }
+        }
+
+        // rescore the vertices that are (or were) in the cache and look for the best triangle touching them
+        best = -1;
+        float bestScore = -1.0f;
+        for (size_t c = 0; c < nextCache.size(); c++)
+        {
+            unsigned int v = nextCache[c];
+            cachePositions[v] = c < (size_t)cacheSize ? (int)c : -1;
+            float score = vertexScore(cachePositions[v], liveTriangles[v]);
+            float delta = score - vertexScores[v];
+            vertexScores[v] = score;
+            for (unsigned int a = 0; a < liveTriangles[v]; a++)
+            {
+                unsigned int t = adjacency[adjacencyOffsets[v] + a];
+                triangleScores[t] += delta;
+            }
+        }
+        for (size_t c = 0; c < nextCache.size() && c < (size_t)cacheSize; c++)
+        {
+            unsigned int v = nextCache[c];
+            for (unsigned int a = 0; a < liveTriangles[v]; a++)
+            {
+                unsigned int t = adjacency[adjacencyOffsets[v] + a];
+                if (triangleScores[t] > bestScore)
+                {
+                    bestScore = triangleScores[t];
+                    best = t;
+                }
+            }
+        }
+        if (nextCache.size() > (size_t)cacheSize)
+            nextCache.resize(cacheSize);
+        cache.swap(nextCache);
+
+        // nothing in the cache has triangles left, continue with the next triangle in input order
+        if (best < 0)
+        {
+            while (inputCursor < triangleCount && emitted[inputCursor])
+                inputCursor++;
+            if (inputCursor < triangleCount)
+                best = (long)inputCursor;
+        }
+    }
+    indices.swap(result);
+}
+
+inline void optimizeOverdraw(vector<unsigned int> &indices, const vector<Vertex> &vertices, float threshold = 1.05f)
+{
+    const unsigned int cacheSize = 16;
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2)
+        return;
+
+    // hard boundaries: triangles where the cache simulation starts over (all three vertices miss)
+    vector<size_t> clusterStarts;
+    {
+        vector<unsigned int> timestamps(vertices.size(), 0);
+        unsigned int time = cacheSize + 1;
+        vector<size_t> hardStarts;
+        vector<unsigned int> triangleMisses(triangleCount);
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            unsigned int misses = 0;
+            for (int c = 0; c < 3; c++)
+            {
+                unsigned int index = indices[t * 3 + c];
+                if (time - timestamps[index] > cacheSize)
+                {
+                    timestamps[index] = time++;
+                    misses++;
+                }
+            }
+            triangleMisses[t] = misses;
+            if (t == 0 || misses == 3)
+                hardStarts.push_back(t);
+        }
+        hardStarts.push_back(triangleCount);
+
+        // soft boundaries: split a hard cluster further wherever the running ACMR is within threshold of the cluster's.
+        // the running ACMR is simulated with the cache starting out empty at the running cluster, as it will
+        // once the clusters are reordered
+        for (size_t h = 0; h + 1 < hardStarts.size(); h++)
+        {
+            size_t begin = hardStarts[h], end = hardStarts[h + 1];
+            unsigned int clusterMisses = 0;
+            for (size_t t = begin; t < end; t++)
+                clusterMisses += triangleMisses[t];
+            float clusterAcmr = float(clusterMisses) / float(end - begin);
+
+            clusterStarts.push_back(begin);
+            unsigned int runningMisses = 0;
+            size_t runningStart = begin;
+            time += cacheSize + 1;
+            for (size_t t = begin; t < end; t++)
+            {
+                for (int c = 0; c < 3; c++)
+                {
+                    unsigned int index = indices[t * 3 + c];
+                    if (time - timestamps[index] > cacheSize)
+                    {
+                        timestamps[index] = time++;
+                        runningMisses++;
+                    }
+                }
+                size_t runningTriangles = t + 1 - runningStart;
+                if (t + 1 < end && runningTriangles >= 8 && float(runningMisses) / float(runningTriangles) <= threshold * clusterAcmr)
+                {
+                    clusterStarts.push_back(t + 1);
+                    runningStart = t + 1;
+                    runningMisses = 0;
+                    time += cacheSize + 1;
+                }
+            }
+        }
+        clusterStarts.push_back(triangleCount);
+    }
+
+    // sort key of a cluster: how far its area weighted centroid lies outwards along its average normal
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    size_t clusterCount = clusterStarts.size() - 1;
+    vector<glm::vec3> centroids(clusterCount), normals(clusterCount);
+    for (size_t k = 0; k < clusterCount; k++)
+    {
+        glm::vec3 centroid(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = clusterStarts[k]; t < clusterStarts[k + 1]; t++)
+        {
+            const glm::vec3 &a = vertices[indices[t * 3]].Position;
+            const glm::vec3 &b = vertices[indices[t * 3 + 1]].Position;
+            const glm::vec3 &c = vertices[indices[t * 3 + 2]].Position;
+            glm::vec3 faceNormal = glm::cross(b - a, c - a);
+            float faceArea = glm::length(faceNormal);
+            centroid += (a + b + c) * (faceArea / 3.0f);
+            normal += faceNormal;
+            area += faceArea;
+        }
+        centroids[k] = area > 0.0f ? centroid / area : centroid;
+        float normalLength = glm::length(normal);
+        normals[k] = normalLength > 0.0f ? normal / normalLength : normal;
+        meshCentroid += centroid;
+        meshArea += area;
+    }
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    vector<float> keys(clusterCount);
+    vector<size_t> order(clusterCount);
+    for (size_t k = 0; k < clusterCount; k++)
+    {
+        keys[k] = glm::dot(centroids[k] - meshCentroid, normals[k]);
+        order[k] = k;
+    }
+    std::stable_sort(order.begin(), order.end(), [&keys](size_t a, size_t b) { return keys[a] > keys[b]; });
+
+    vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (size_t k : order)
+        result.insert(result.end(), indices.begin() + clusterStarts[k] * 3, indices.begin() + clusterStarts[k + 1] * 3);
+    indices.swap(result);
+}
+
+inline void optimizeVertexFetch(vector<Vertex> &vertices, vector<unsigned int> &indices)
+{
+    const unsigned int unused = ~0u;
+    vector<unsigned int> remap(vertices.size(), unused);
+    vector<Vertex> reordered;
+    reordered.reserve(vertices.size());
+    for (unsigned int &index : indices)
+    {
+        if (remap[index] == unused)
+        {
+            remap[index] = (unsigned int)reordered.size();
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(reordered);
+}
+
+// runs all stages on an imported mesh and reports the cache efficiency before and after reordering
+inline void optimizeMesh(MeshData &mesh, const string &name)
+{
+    size_t verticesBefore = mesh.vertices.size();
+    weldVertices(mesh.vertices, mesh.indices);
+    // measured on the welded mesh in import order, unwelded every vertex is a miss
+    VertexCacheStatistics before = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+
+    optimizeVertexCache(mesh.indices, mesh.vertices.size());
+    optimizeOverdraw(mesh.indices, mesh.vertices);
+    optimizeVertexFetch(mesh.vertices, mesh.indices);
+
+    VertexCacheStatistics after = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+    std::cout << "MESH_OPTIMIZER:: " << name << ": vertices " << verticesBefore << " -> " << mesh.vertices.size()
+              << ", ACMR " << before.acmr << " -> " << after.acmr
+              << ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+}
+
+// splits a mesh into consecutive runs of its triangles referencing at most maxVertices vertices each, so every
+// part can be drawn with 16 bit indices. The triangle order is kept, the vertices of each part are in first use order.
+inline vector<MeshData> splitMesh(MeshData mesh, size_t maxVertices = 65536)
+{
+    vector<MeshData> parts;
+    if (mesh.vertices.size() <= maxVertices)
+    {
+        parts.push_back(std::move(mesh));
+        return parts;
+    }
+
+    const unsigned int unused = ~0u;
+    vector<unsigned int> remap(mesh.vertices.size(), unused);
+    vector<unsigned int> used;  // vertices remapped for the current part, reset when it is full
+    MeshData part;
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+    {
+        size_t added = 0;
+        for (int k = 0; k < 3; k++)
+            added += remap[mesh.indices[i + k]] == unused ? 1 : 0;
+        if (part.vertices.size() + added > maxVertices)
+        {
+            part.textures = mesh.textures;
+            part.bounds = Mesh::computeBounds(part.vertices);
+            parts.push_back(std::move(part));
+            part = MeshData();
+            for (unsigned int vertex : used)
+                remap[vertex] = unused;
+            used.clear();
+        }
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int &target = remap[mesh.indices[i + k]];
+            if (target == unused)
+            {
+                target = (unsigned int)part.vertices.size();
+                part.vertices.push_back(mesh.vertices[mesh.indices[i + k]]);
+                used.push_back(mesh.indices[i + k]);
+            }
+            part.indices.push_back(target);
+        }
+    }
+    part.textures = mesh.textures;
+    part.bounds = Mesh::computeBounds(part.vertices);
+    parts.push_back(std::move(part));
+    return parts;
+}
+#endif
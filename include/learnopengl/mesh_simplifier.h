@@ -0,0 +1,259 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/mesh_optimizer.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <iostream>
+
+// Import time generation of levels of detail by quadric error edge collapse (after Garland and Heckbert,
+// "Surface Simplification Using Quadric Error Metrics").
+//
+// Collapses only move a vertex onto one of its neighbours, so every level indexes the vertices of the full
+// mesh and the levels share its vertex buffer. Vertices on open borders and on attribute seams (several
+// vertices at the same position) are never moved, which keeps holes closed and texture coordinates intact.
+
+// sum of squared distances to a set of planes, evaluated at a point
+struct Quadric {
+    double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+
+    static Quadric fromPlane(double a, double b, double c, double d)
+    {
+        Quadric q;
+        q.a2 = a * a; q.ab = a * b; q.ac = a * c; q.ad = a * d;
+        q.b2 = b * b; q.bc = b * c; q.bd = b * d;
+        q.c2 = c * c; q.cd = c * d;
+        q.d2 = d * d;
+        return q;
+    }
+
+    void add(const Quadric &q)
+    {
+        a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+        b2 += q.b2; bc += q.bc; bd += q.bd;
+        c2 += q.c2; cd += q.cd;
+        d2 += q.d2;
+    }
+
+    double error(const glm::vec3 &p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double result = a2 * x * x + b2 * y * y + c2 * z * z + d2
+                      + 2 * (ab * x * y + ac * x * z + bc * y * z + ad * x + bd * y + cd * z);
+        return result > 0 ? result : 0;
+    }
+};
+
+struct PositionHash {
+    size_t operator()(const glm::vec3 &position) const
+    {
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&position);
+        size_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < sizeof(glm::vec3); i++)
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        return hash;
+    }
+};
+
+struct PositionEqual {
+    bool operator()(const glm::vec3 &a, const glm::vec3 &b) const { return memcmp(&a, &b, sizeof(glm::vec3)) == 0; }
+};
+
+// simplifies a triangle list towards targetIndexCount without exceeding maxError (a distance in model units).
+// returns the new index list, the largest error of the collapses taken is stored in resultError.
+inline vector<unsigned int> simplifyMesh(const vector<Vertex> &vertices, const vector<unsigned int> &indices,
+                                         size_t targetIndexCount, float maxError, float &resultError)
+{
+    size_t vertexCount = vertices.size();
+    vector<unsigned int> result = indices;
+    resultError = 0.0f;
+
+    // vertices sharing a position are seams
+    vector<unsigned int> positionOf(vertexCount);
+    {
+        std::unordered_map<glm::vec3, unsigned int, PositionHash, PositionEqual> first;
+        for (size_t i = 0; i < vertexCount; i++)
+            positionOf[i] = first.insert({vertices[i].Position, (unsigned int)i}).first->second;
+    }
+    vector<unsigned int> positionUses(vertexCount, 0);
+    for (size_t i = 0; i < vertexCount; i++)
+        positionUses[positionOf[i]]++;
+
+    // an edge is on a border when only one triangle uses it, compared by position so seams are not borders
+    vector<bool> locked(vertexCount, false);
+    {
+        std::unordered_map<uint64_t, unsigned int> edges;
+        auto edgeKey = [](unsigned int a, unsigned int b) { return (uint64_t)a << 32 | b; };
+        for (size_t i = 0; i < result.size(); i += 3)
+            for (int k = 0; k < 3; k++)
+                edges[edgeKey(positionOf[result[i + k]], positionOf[result[i + (k + 1) % 3]])]++;
+        for (size_t i = 0; i < result.size(); i += 3)
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int a = result[i + k], b = result[i + (k + 1) % 3];
+                if (!edges.count(edgeKey(positionOf[b], positionOf[a])))
+                    locked[a] = locked[b] = true;
+            }
+        for (size_t i = 0; i < vertexCount; i++)
+            if (positionUses[positionOf[i]] > 1)
+                locked[i] = true;
+    }
+
+    vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < result.size(); i += 3)
+    {
+        const glm::vec3 &p0 = vertices[result[i]].Position;
+        glm::vec3 normal = glm::cross(vertices[result[i + 1]].Position - p0, vertices[result[i + 2]].Position - p0);
+        float length = glm::length(normal);
+        if (length == 0.0f)
+            continue;
+        normal /= length;
+        Quadric plane = Quadric::fromPlane(normal.x, normal.y, normal.z, -glm::dot(normal, p0));
+        for (int k = 0; k < 3; k++)
+            quadrics[result[i + k]].add(plane);
+    }
+
+    struct Collapse {
+        unsigned int from, to;
+        double cost;
+    };
+    vector<unsigned int> triangleOffsets, triangles, remap(vertexCount);
+    vector<Collapse> collapses;
+    vector<bool> touched(vertexCount);
+    double maxCost = (double)maxError * maxError;
+
+    while (result.size() > targetIndexCount)
+    {
+        // triangles around every vertex
+        triangleOffsets.assign(vertexCount + 1, 0);
+        for (unsigned int index : result)
+            triangleOffsets[index + 1]++;
+        for (size_t i = 0; i < vertexCount; i++)
+            triangleOffsets[i + 1] += triangleOffsets[i];
+        triangles.resize(result.size());
+        {
+            vector<unsigned int> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+            for (size_t i = 0; i < result.size(); i++)
+                triangles[fill[result[i]]++] = (unsigned int)(i / 3);
+        }
+
+        collapses.clear();
+        for (size_t i = 0; i < result.size(); i += 3)
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int a = result[i + k], b = result[i + (k + 1) % 3];
+                Quadric q = quadrics[a];
+                q.add(quadrics[b]);
+                if (!locked[a])
+                    collapses.push_back({a, b, q.error(vertices[b].Position)});
+                if (!locked[b])
+                    collapses.push_back({b, a, q.error(vertices[a].Position)});
+            }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse &x, const Collapse &y) { return x.cost < y.cost; });
+
+        // take the cheapest collapses whose neighbourhoods do not overlap, so the checks below stay valid
+        for (size_t i = 0; i < vertexCount; i++)
+            remap[i] = (unsigned int)i;
+        std::fill(touched.begin(), touched.end(), false);
+        size_t triangleCount = result.size() / 3, targetTriangles = targetIndexCount / 3;
+        size_t collapsed = 0;
+        for (const Collapse &collapse : collapses)
+        {
+            if (collapse.cost > maxCost || triangleCount <= targetTriangles)
+                break;
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+
+            // reject collapses that flip a triangle around the moved vertex
+            const glm::vec3 &target = vertices[collapse.to].Position;
+            bool flips = false;
+            size_t removed = 0;
+            for (unsigned int t = triangleOffsets[collapse.from]; t < triangleOffsets[collapse.from + 1] && !flips; t++)
+            {
+                const unsigned int *triangle = &result[triangles[t] * 3];
+                if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+                {
+                    removed++;
+                    continue;
+                }
+                glm::vec3 p[3], q[3];
+                for (int k = 0; k < 3; k++)
+                {
+                    p[k] = vertices[triangle[k]].Position;
+                    q[k] = triangle[k] == collapse.from ? target : p[k];
+                }
+                glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+                flips = glm::dot(before, after) <= 0.0f;
+            }
+            if (flips)
+                continue;
+
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to].add(quadrics[collapse.from]);
+            resultError = std::max(resultError, (float)std::sqrt(collapse.cost));
+            for (unsigned int t = triangleOffsets[collapse.from]; t < triangleOffsets[collapse.from + 1]; t++)
+                for (int k = 0; k < 3; k++)
+                    touched[result[triangles[t] * 3 + k]] = true;
+            triangleCount -= removed;
+            collapsed++;
+        }
+        if (collapsed == 0)
+            break;
+
+        // apply the collapses and drop the triangles that became degenerate
+        size_t write = 0;
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            unsigned int a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+            if (a == b || b == c || c == a)
+                continue;
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+    return result;
+}
+
+// appends coarser levels to mesh.lods, each aiming at half the triangles of the previous one. Stops early when a
+// level would not save enough or would deviate from the original surface by more than maxRelativeError times
+// the size of the mesh bounds.
+inline void generateLods(MeshData &mesh, const string &name, unsigned int maxLevels = 3, float maxRelativeError = 0.02f)
+{
+    mesh.lods.clear();
+    if (mesh.indices.size() < 3 * 256)
+        return;
+
+    float extent = glm::length(mesh.bounds.max - mesh.bounds.min);
+    const vector<unsigned int> *previous = &mesh.indices;
+    std::cout << "MESH_SIMPLIFIER:: " << name << ": triangles " << mesh.indices.size() / 3;
+    for (unsigned int level = 1; level <= maxLevels; level++)
+    {
+        size_t target = (mesh.indices.size() >> level) / 3 * 3;
+        float error;
+        vector<unsigned int> indices = simplifyMesh(mesh.vertices, mesh.indices, target, extent * maxRelativeError, error);
+        if (indices.empty() || indices.size() > previous->size() * 8 / 10)
+            break;
+        optimizeVertexCache(indices, mesh.vertices.size());
+
+        MeshLod lod;
+        lod.indices = std::move(indices);
+        lod.error = error;
+        mesh.lods.push_back(std::move(lod));
+        previous = &mesh.lods.back().indices;
+        std::cout << " -> " << previous->size() / 3 << " (error " << error << ")";
+    }
+    std::cout << std::endl;
+}
+#endif
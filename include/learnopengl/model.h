@@ -10,13 +10,20 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <learnopengl/geometry_arena.h>
 #include <learnopengl/mesh.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/mesh_optimizer.h>
+#include <learnopengl/mesh_simplifier.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/texture.h>
+#include <learnopengl/thread_pool.h>
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <future>
 #include <map>
 #include <vector>
 using namespace std;
@@ -25,26 +32,175 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
 
 
 
+// CPU side result of importing a model file. Producing it does not touch OpenGL, so it can be done on a worker thread.
+struct ModelData
+{
+    string directory;
+    vector<MeshData> meshes;
+
+    // starts decoding the textures of a mesh on the pool, ahead of the upload
+    void decodeTextures(const MeshData &mesh, ThreadPool &pool)
+    {
+        for (const TextureReference &texture : mesh.textures)
+            TextureManager::instance().prefetch(directory + '/' + texture.path, pool);
+    }
+};
+
+// what Model::Draw needs to know about the camera to choose levels of detail
+struct LodView
+{
+    glm::vec3 cameraPosition;
+    float pixelsPerUnit;     // size in pixels of one world unit at distance 1, viewport height / (2 tan(fovy / 2))
+    float threshold = 1.0f;  // largest error allowed on screen, in pixels
+};
+
+// levels of detail chosen for one placement of a model, kept from frame to frame for the hysteresis
+struct LodState
+{
+    vector<unsigned int> levels;
+};
+
+// how the GL side of a model is set up
+struct ModelOptions
+{
+    VertexFormat vertexFormat = VertexFormat::Full;
+    GeometryResidency residency = GeometryResidency::Keep;
+    // appends the geometry to this arena instead of creating buffers of the model's own, the arena has to
+    // outlive the model and use vertexFormat
+    GeometryArena *arena = nullptr;
+};
+
 class Model
 {
 public:
     // model data
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    ModelOptions options;
+    // system memory taken by the meshes' geometry copies after applying options.residency, and how much it saved
+    size_t residentGeometryBytes = 0;
+    size_t releasedGeometryBytes = 0;
+    // vertex array and buffers shared by all meshes, the buffers stay 0 when they belong to options.arena
+    unsigned int VAO = 0, VBO = 0, EBO = 0;
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    Model(string const &path, bool gamma = false, const ModelOptions &options = ModelOptions())
+        : gammaCorrection(gamma), options(options)
+    {
+        ModelData data = importModel(path);
+        upload(data);
+    }
+
+    // constructor for a model imported ahead of time (see importAsync), only creates the GL objects.
+    explicit Model(ModelData data, bool gamma = false, const ModelOptions &options = ModelOptions())
+        : gammaCorrection(gamma), options(options)
+    {
+        upload(data);
+    }
+
+    // the textures are shared through the TextureManager, every mesh texture holds one reference
+    Model(const Model &) = delete;
+    Model &operator=(const Model &) = delete;
+    Model(Model &&) = default;
+    Model &operator=(Model &&) = default;
+
+    ~Model()
+    {
+        for (const Mesh &mesh : meshes)
+            for (const Texture &texture : mesh.textures)
+                TextureManager::instance().release(texture.id);
+    }
+
+    // runs the CPU half of loading (mesh cache or ASSIMP import) on the pool. The result has to be passed
+    // to the Model constructor on the thread owning the GL context. See importModel for levelsOfDetail.
+    static std::future<ModelData> importAsync(ThreadPool &pool, string const &path, bool levelsOfDetail = true)
     {
-        loadModel(path);
+        return pool.submit([path, &pool, levelsOfDetail] { return importModel(path, &pool, levelsOfDetail); });
+    }
+
+    // loads a model with supported ASSIMP extensions from file and returns its meshes.
+    // a model that was imported before is read back from the mesh cache without touching ASSIMP.
+    // with a pool the textures of every mesh start decoding on it as soon as the mesh is known.
+    // without levelsOfDetail no coarser levels are generated, for models only ever drawn at full detail.
+    static ModelData importModel(string const &path, ThreadPool *pool = nullptr, bool levelsOfDetail = true)
+    {
+        const unsigned int importFlags = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+        ModelData data;
+        // retrieve the directory path of the filepath
+        data.directory = path.substr(0, path.find_last_of('/'));
+
+        MeshCache cache(path, importFlags, levelsOfDetail);
+        if (loadFromCache(cache, data, pool))
+            return data;
+
+        // read file via ASSIMP
+        Assimp::Importer importer;
+        const aiScene* scene = importer.ReadFile(path, importFlags);
+        // check for errors
+        if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+        {
+            cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+            return data;
+        }
+
+        // process ASSIMP's root node recursively
+        processNode(scene->mRootNode, scene, data, pool);
+
+        // weld and reorder the geometry for the GPU, only done on a cache miss since the cache stores the result.
+        // meshes too large for 16 bit indices are split into submeshes afterwards, then every submesh gets its
+        // levels of detail when the model uses them
+        vector<MeshData> meshes;
+        for (size_t i = 0; i < data.meshes.size(); i++)
+        {
+            string name = path + " mesh " + std::to_string(i);
+            optimizeMesh(data.meshes[i], name);
+            for (MeshData &part : splitMesh(std::move(data.meshes[i])))
+            {
+                if (levelsOfDetail)
+                    generateLods(part, name);
+                meshes.push_back(std::move(part));
+            }
+        }
+        data.meshes = std::move(meshes);
+
+        cache.store(data.meshes);
+        return data;
     }
 
     // draws the model, and thus all its meshes
     void Draw(Shader &shader)
     {
+        // all meshes live in the same buffers, so the vertex array is bound once for the whole model
+        GLState::instance().bindVertexArray(VAO);
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].DrawBound(shader);
+    }
+
+    // draws the model placed with the given model matrix, every mesh at the coarsest level of detail whose error
+    // stays below view.threshold pixels on screen
+    void Draw(Shader &shader, const glm::mat4 &model, const LodView &view, LodState &state)
+    {
+        selectLods(model, view, state);
+        GLState::instance().bindVertexArray(VAO);
         for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+            meshes[i].DrawBound(shader, state.levels[i]);
+    }
+
+    // submits all meshes to a render queue, item brings the pass, program and transform
+    void Draw(RenderQueue &queue, const DrawItem &item)
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].Draw(queue, item);
+    }
+
+    // submits all meshes to a render queue at the levels of detail Draw(shader, model, view, state) would use,
+    // item.transform has to be set
+    void Draw(RenderQueue &queue, const DrawItem &item, const LodView &view, LodState &state)
+    {
+        selectLods(item.transform->model(), view, state);
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].Draw(queue, item, state.levels[i]);
     }
 
     void SetShaderTextureNamePrefix(std::string prefix) {
@@ -53,27 +209,94 @@ public:
         }
     }
 private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const &path)
+    // chooses the level of detail of every mesh for the placement model into state.levels
+    void selectLods(const glm::mat4 &model, const LodView &view, LodState &state) const
     {
-        // read file via ASSIMP
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-        // check for errors
-        if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+        state.levels.resize(meshes.size(), 0);
+        // the largest scale of the model matrix turns model space errors into world units
+        float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+
+        for(unsigned int i = 0; i < meshes.size(); i++)
         {
-            cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
+            const AABB &bounds = meshes[i].bounds;
+            glm::vec3 center = glm::vec3(model * glm::vec4((bounds.min + bounds.max) * 0.5f, 1.0f));
+            float radius = glm::length(bounds.max - bounds.min) * 0.5f * scale;
+            // distance to the nearest point of the bounding sphere, full detail when the camera is inside it
+            float distance = glm::length(center - view.cameraPosition) - radius;
+            unsigned int level = 0;
+            if (distance > 0.0f)
+                level = meshes[i].selectLod(view.pixelsPerUnit * scale / distance, state.levels[i], view.threshold);
+            state.levels[i] = level;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
+    }
 
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+    // creates the textures and GL buffers of imported mesh data, must run on the thread owning the GL context.
+    void upload(ModelData &data)
+    {
+        directory = data.directory;
+        meshes.reserve(data.meshes.size());
+        SharedGeometry geometry;
+        geometry.format = options.vertexFormat;
+        for (MeshData &mesh : data.meshes)
+        {
+            vector<Texture> textures;
+            for (const TextureReference &reference : mesh.textures)
+            {
+                Texture texture;
+                texture.id = TextureManager::instance().acquire(directory + '/' + reference.path);
+                texture.type = reference.type;
+                texture.path = reference.path;
+                textures.push_back(texture);
+            }
+            meshes.push_back(Mesh(std::move(mesh.vertices), std::move(mesh.indices), textures, mesh.bounds, geometry, std::move(mesh.lods)));
+            releasedGeometryBytes += meshes.back().applyResidency(options.residency);
+            residentGeometryBytes += meshes.back().geometryBytes();
+        }
+
+        if (options.arena && options.arena->format != geometry.format)
+            cout << "ERROR::MODEL:: " << directory << ": the geometry arena has another vertex format, "
+                 << "the model gets buffers of its own" << endl;
+        if (options.arena && options.arena->format == geometry.format)
+        {
+            GeometryArena::Range range = options.arena->append(geometry);
+            for (Mesh &mesh : meshes)
+                mesh.relocate(range.baseVertex, range.indexOffset);
+            VAO = options.arena->VAO;
+        }
+        else
+            VAO = Mesh::uploadShared(geometry, VBO, EBO);
+        for (Mesh &mesh : meshes)
+            mesh.VAO = VAO;
+        if (releasedGeometryBytes)
+            cout << "MODEL:: " << directory << ": released " << releasedGeometryBytes << " bytes of geometry after upload, "
+                 << residentGeometryBytes << " bytes kept" << endl;
+    }
+
+    // copies the meshes out of the memory mapped cache entry, returns false on a cache miss
+    static bool loadFromCache(MeshCache &cache, ModelData &data, ThreadPool *pool)
+    {
+        vector<MeshCacheEntry> entries;
+        if (!cache.load(entries))
+            return false;
+        for (const MeshCacheEntry &entry : entries)
+        {
+            MeshData mesh;
+            mesh.vertices.assign(entry.vertices, entry.vertices + entry.vertexCount);
+            mesh.indices.assign(entry.indices, entry.indices + entry.indexCount);
+            for (const MeshCacheLod &lod : entry.lods)
+                mesh.lods.push_back({vector<unsigned int>(lod.indices, lod.indices + lod.indexCount), lod.error});
+            for (const MeshCacheTexture &texture : entry.textures)
+                mesh.textures.push_back({string(texture.type, texture.typeLength), string(texture.path, texture.pathLength)});
+            mesh.bounds = entry.bounds;
+            if (pool)
+                data.decodeTextures(mesh, *pool);
+            data.meshes.push_back(std::move(mesh));
+        }
+        return true;
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    static void processNode(aiNode *node, const aiScene *scene, ModelData &data, ThreadPool *pool)
     {
         // process each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
@@ -81,22 +304,25 @@ private:
             // the node object only contains indices to index the actual objects in the scene.
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            data.meshes.push_back(processMesh(mesh, scene));
+            if (pool)
+                data.decodeTextures(data.meshes.back(), *pool);
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, data, pool);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    static MeshData processMesh(aiMesh *mesh, const aiScene *scene)
     {
         // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        MeshData data;
+        vector<Vertex> &vertices = data.vertices;
+        vector<unsigned int> &indices = data.indices;
+        vector<TextureReference> &textures = data.textures;
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -116,6 +342,8 @@ private:
                 vector.z = mesh->mNormals[i].z;
                 vertex.Normal = vector;
             }
+            else
+                vertex.Normal = glm::vec3(0.0f);
             // texture coordinates
             if(mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
             {
@@ -137,7 +365,12 @@ private:
                 vertex.Bitangent = vector;
             }
             else
+            {
                 vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+                // zero rather than uninitialized, so identical vertices can be welded
+                vertex.Tangent = glm::vec3(0.0f);
+                vertex.Bitangent = glm::vec3(0.0f);
+            }
 
             vertices.push_back(vertex);
 
@@ -164,55 +397,28 @@ private:
 
 
         // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+        loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", textures);
         // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+        loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", textures);
         // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+        loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal", textures);
         // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-
+        loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height", textures);
 
-
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        data.bounds = Mesh::computeBounds(vertices);
+        // return the extracted mesh data, the GL objects are created later on the context thread
+        return data;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // collects all material textures of a given type, the images themselves are loaded when the model is uploaded.
+    static void loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName, vector<TextureReference> &textures)
     {
-        vector<Texture> textures;
         for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            textures.push_back({typeName, str.C_Str()});
         }
-        return textures;
     }
 };
 
@@ -222,38 +428,6 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
     string filename = string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    return uploadTextureImage(decodeTextureImage(filename), path);
 }
 #endif
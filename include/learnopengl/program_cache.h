@@ -0,0 +1,172 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+#include <learnopengl/hash.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include <sys/stat.h>
+
+// On-disk cache of linked program binaries (ARB_get_program_binary, core in GL 4.1).
+//
+// Every program gets one file in PROGRAM_CACHE_DIRECTORY, named after its shader files and defines. The header
+// holds a key combining the hash of the shader sources with the GL vendor, renderer and version strings, so after
+// editing a shader or updating the driver the entry no longer matches and is overwritten by the next store. The
+// directory keeps one file per program however often the shaders are edited (see ShaderWatcher). The layout is a
+// ProgramCacheHeader followed by the binary.
+//
+// Drivers may still reject a binary (e.g. after an update that did not change the version string), so a failed
+// load is not an error: the caller compiles from source and stores the new binary.
+
+#define PROGRAM_CACHE_DIRECTORY "resources/cache"
+#define PROGRAM_CACHE_VERSION 1u
+
+static const char PROGRAM_CACHE_MAGIC[4] = {'T', 'P', 'P', 'B'};
+
+struct ProgramCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint32_t format;
+    uint32_t length;
+};
+
+class ProgramCache {
+public:
+    ProgramCache() = default;
+
+    // sources are the shader files of the program, an empty one stands for a missing stage. Needs a current
+    // GL context.
+    ProgramCache(const std::string &name, const std::vector<const std::string *> &sources)
+    {
+        if (!GLAD_GL_ARB_get_program_binary)
+            return;
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        if (formats == 0)
+            return;
+
+        uint32_t version = PROGRAM_CACHE_VERSION;
+        key = fnv1a64(&version, sizeof(version));
+        for (const std::string *source : sources)
+        {
+            uint64_t length = source->size();
+            key = fnv1a64(&length, sizeof(length), key);
+            key = fnv1a64(source->data(), source->size(), key);
+        }
+        const GLenum strings[] = {GL_VENDOR, GL_RENDERER, GL_VERSION};
+        for (GLenum string : strings)
+        {
+            const char *value = reinterpret_cast<const char *>(glGetString(string));
+            if (value)
+                key = fnv1a64(value, strlen(value) + 1, key);
+        }
+
+        cachePath = std::string(PROGRAM_CACHE_DIRECTORY) + '/' + name + ".program";
+    }
+
+    bool valid() const { return !cachePath.empty(); }
+
+    // asks the driver to keep the binary of program around, call before linking it from source
+    void prepare(GLuint program) const
+    {
+        if (valid())
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // hands the cached binary to program. The driver may still reject it, which shows as a failed GL_LINK_STATUS
+    // (queried by the caller, so the check can be deferred like that of a program linked from source).
+    bool load(GLuint program) const
+    {
+        if (!valid())
+            return false;
+        FILE *in = fopen(cachePath.c_str(), "rb");
+        if (!in)
+            return false;
+
+        ProgramCacheHeader header;
+        std::vector<char> binary;
+        bool ok = fread(&header, sizeof(header), 1, in) == 1
+                  && memcmp(header.magic, PROGRAM_CACHE_MAGIC, sizeof(PROGRAM_CACHE_MAGIC)) == 0
+                  && header.version == PROGRAM_CACHE_VERSION && header.length > 0;
+        // built from other sources or for another driver, not an error
+        if (ok && header.key != key)
+        {
+            fclose(in);
+            return false;
+        }
+        if (ok)
+        {
+            binary.resize(header.length);
+            ok = fread(binary.data(), 1, binary.size(), in) == binary.size();
+        }
+        fclose(in);
+        if (!ok)
+        {
+            std::cout << "ERROR::PROGRAM_CACHE:: ignoring invalid cache file " << cachePath << std::endl;
+            return false;
+        }
+
+        glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+        return true;
+    }
+
+    const std::string &path() const { return cachePath; }
+
+    // writes the binary of a program linked from source, aside and renamed like the mesh cache
+    bool store(GLuint program) const
+    {
+        if (!valid())
+            return false;
+        GLint linked = 0, length = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (!linked || length <= 0)
+            return false;
+
+        ProgramCacheHeader header;
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        glGetProgramBinary(program, length, &length, &format, binary.data());
+        memcpy(header.magic, PROGRAM_CACHE_MAGIC, sizeof(PROGRAM_CACHE_MAGIC));
+        header.version = PROGRAM_CACHE_VERSION;
+        header.key = key;
+        header.format = format;
+        header.length = (uint32_t)length;
+
+        mkdir(PROGRAM_CACHE_DIRECTORY, 0755);
+        std::string tempPath = cachePath + ".tmp";
+        FILE *out = fopen(tempPath.c_str(), "wb");
+        bool ok = out != nullptr;
+        if (out)
+        {
+            ok = fwrite(&header, sizeof(header), 1, out) == 1;
+            ok = ok && fwrite(binary.data(), 1, header.length, out) == header.length;
+            ok = (fclose(out) == 0) && ok;
+        }
+        if (!ok || rename(tempPath.c_str(), cachePath.c_str()) != 0)
+        {
+            std::cout << "ERROR::PROGRAM_CACHE:: could not write " << cachePath << std::endl;
+            remove(tempPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    uint64_t key = 0;
+    std::string cachePath;
+};
+
+// file name of a shader path without its directories, used to name cache entries
+inline std::string programCacheName(const std::string &path)
+{
+    return path.substr(path.find_last_of('/') + 1);
+}
+#endif
@@ -0,0 +1,702 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/frustum.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/transform.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <set>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+// Draws collected over a frame and executed in an order that keeps GL state changes down.
+//
+// Every draw is submitted as a DrawItem with a 64 bit sort key. From the most to the least significant bits the
+// key holds the pass, the program, the material, the vertex array and the distance to the camera, so sorting the
+// keys groups the draws by program first and, inside a group, draws near objects first for early depth rejection.
+// The keys are sorted with a least significant digit radix sort, linear in the number of draws and stable, so
+// draws with equal keys keep the order they were submitted in. When executing, programs, vertex arrays and
+// textures are only bound when they differ from what is bound already.
+//
+// Draws of the same geometry with the same state that only differ in their transform (several placements of one
+// Model) are merged into one instanced draw when they come with an instanced program, see DrawItem::instancedShader.
+// Their transforms are written to an instance buffer once per frame and read by the vertex shader from the
+// attributes at INSTANCE_MODEL_ATTRIBUTE and INSTANCE_NORMAL_ATTRIBUTE (see transform.glsl), so a hundred chairs
+// take one draw per submesh.
+//
+// Draws submitted with their bounds are culled against the view frustum given to begin before anything else, all
+// of them at once with FrustumCuller, so only the visible ones are merged, sorted and drawn.
+//
+// With multi draw on (setMultiDraw), the merging goes further: indexed draws with the same program, material and
+// vertex array become one batch even when they draw different geometry, each geometry one indirect command. Meshes
+// sharing a GeometryArena share their vertex array, so a whole class of static geometry is drawn with a single
+// glMultiDrawElementsIndirect (GL 4.3 or ARB_multi_draw_indirect). Without it the same command list is looped with
+// one instanced draw per command. Textures cannot change inside a multi draw, so the batches still split by
+// material.
+
+// vertex attributes of the per instance transform: the model matrix takes four locations, the normal matrix three
+#define INSTANCE_MODEL_ATTRIBUTE 5
+#define INSTANCE_NORMAL_ATTRIBUTE 9
+
+// textures of a draw, bound to units 0..n-1, and the sampler uniforms reading them. An empty sampler name means
+// the program was pointed at the unit up front.
+struct Material {
+    std::vector<unsigned int> textures;
+    std::vector<std::string> samplers;
+};
+
+// one Material for every distinct set of textures and sampler names. Draws are batched by their Material pointer,
+// meshes that only share their textures through the TextureManager would never end up in the same batch without it.
+class MaterialRegistry {
+public:
+    static MaterialRegistry &instance()
+    {
+        static MaterialRegistry registry;
+        return registry;
+    }
+
+    // the registered Material equal to material, stays valid for the lifetime of the program
+    const Material *intern(const Material &material) { return &*materials.insert(material).first; }
+
+    size_t size() const { return materials.size(); }
+
+private:
+    struct ContentsLess {
+        bool operator()(const Material &a, const Material &b) const
+        {
+            return std::tie(a.textures, a.samplers) < std::tie(b.textures, b.samplers);
+        }
+    };
+
+    // set elements keep their address
+    std::set<Material, ContentsLess> materials;
+
+    MaterialRegistry() = default;
+};
+
+// handles of the uniforms set with every draw, the position dequantization and the material samplers. They are
+// looked up once per program, and the samplers once per program and Material, so drawing does not hash uniform
+// names. Programs and Materials are told apart by their address, they have to stay where they are (as the ones
+// from MaterialRegistry do). Handles stay valid when a program is reloaded.
+class DrawUniforms {
+public:
+    static DrawUniforms &instance()
+    {
+        static DrawUniforms uniforms;
+        return uniforms;
+    }
+
+    struct Program {
+        UniformHandle positionScale;
+        UniformHandle positionOffset;
+        // the sampler of every texture unit of a Material, unused where the sampler name is empty
+        std::unordered_map<const Material *, std::vector<UniformHandle>> samplers;
+    };
+
+    Program &program(Shader &shader)
+    {
+        auto found = programs.find(&shader);
+        if (found != programs.end())
+            return found->second;
+        Program &handles = programs[&shader];
+        handles.positionScale = shader.uniform("positionScale");
+        handles.positionOffset = shader.uniform("positionOffset");
+        return handles;
+    }
+
+    // handles is program(shader)
+    const std::vector<UniformHandle> &samplers(Shader &shader, Program &handles, const Material &material)
+    {
+        auto found = handles.samplers.find(&material);
+        if (found != handles.samplers.end())
+            return found->second;
+        std::vector<UniformHandle> &units = handles.samplers[&material];
+        for (const std::string &name : material.samplers)
+            units.push_back(name.empty() ? UniformHandle{0} : shader.uniform(name));
+        return units;
+    }
+
+private:
+    std::unordered_map<const Shader *, Program> programs;
+
+    DrawUniforms() = default;
+};
+
+// one draw call and the state it needs
+struct DrawItem {
+    unsigned int pass = 0;                 // passes are drawn in increasing order, 0 to 15
+    Shader *shader = nullptr;
+    const Transform *transform = nullptr;  // uploaded through transformUniforms when set
+    TransformUniforms transformUniforms = {};
+    // variant of shader taking the transform from the instance attributes, lets the item be drawn instanced
+    Shader *instancedShader = nullptr;
+    const Material *material = nullptr;    // nullptr leaves the textures alone
+    unsigned int vao = 0;
+    // glDrawElementsBaseVertex when indexType is set, glDrawArrays otherwise
+    GLenum indexType = 0;
+    GLsizei count = 0;
+    size_t first = 0;                      // byte offset of the first index, or the first vertex
+    GLint baseVertex = 0;
+    // dequantization of packed positions (see Mesh), identity for float positions
+    glm::vec3 positionScale = glm::vec3(1.0f);
+    glm::vec3 positionOffset = glm::vec3(0.0f);
+    // filled in by the queue
+    uint64_t key = 0;
+    float distance = 0.0f;
+    // merged draws: the instanced draws of the commands from firstCommand on, count to baseVertex are unused then
+    GLsizei commandCount = 0;
+    size_t firstCommand = 0;
+};
+
+// state changes made by executing a frame of draws
+struct RenderStateChanges {
+    unsigned long long programs = 0;
+    unsigned long long vertexArrays = 0;
+    unsigned long long textures = 0;
+
+    RenderStateChanges &operator+=(const RenderStateChanges &other)
+    {
+        programs += other.programs;
+        vertexArrays += other.vertexArrays;
+        textures += other.textures;
+        return *this;
+    }
+};
+
+// state changes the draws would have needed in the order they were submitted and sorted, and the ones made after
+// instancing and multi draw merged them
+struct RenderQueueStats {
+    RenderStateChanges submitted;
+    RenderStateChanges sorted;
+    RenderStateChanges merged;
+    unsigned long long frames = 0;
+    unsigned long long draws = 0;      // visible draws
+    unsigned long long culled = 0;     // draws outside the view frustum
+    unsigned long long drawCalls = 0;  // GL draw calls after merging, a multi draw counts once
+    unsigned long long commands = 0;   // instanced draws of the merged items, drawn by multi draws or one by one
+};
+
+// layout of the commands read by glMultiDrawElementsIndirect
+struct IndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;  // in indices, not bytes
+    GLint  baseVertex;
+    GLuint baseInstance;
+};
+
+class RenderQueue {
+public:
+    // starts collecting a frame, distances are measured from viewPosition
+    void begin(const glm::vec3 &viewPosition)
+    {
+        this->viewPosition = viewPosition;
+        items.clear();
+        culler.clear();
+        boundedItems.clear();
+        culling = false;
+    }
+
+    // starts collecting a frame whose draws with bounds are culled against frustum
+    void begin(const glm::vec3 &viewPosition, const Frustum &frustum)
+    {
+        begin(viewPosition);
+        this->frustum = frustum;
+        culling = true;
+    }
+
+    // adds a draw, center is the position in world space its distance is measured to
+    void submit(const DrawItem &item, const glm::vec3 &center)
+    {
+        items.push_back(item);
+        DrawItem &added = items.back();
+        added.distance = glm::length(center - viewPosition);
+        added.key = sortKey(added, added.distance);
+        added.commandCount = 0;
+    }
+
+    // adds a draw that is left out when worldBounds are outside the view frustum
+    void submit(const DrawItem &item, const glm::vec3 &center, const AABB &worldBounds)
+    {
+        submit(item, center);
+        if (!culling)
+            return;
+        culler.add(worldBounds);
+        boundedItems.push_back((uint32_t)(items.size() - 1));
+    }
+
+    // batches draws of different geometry into multi draws, takes effect with the next execute
+    void setMultiDraw(bool enabled) { multiDraw = enabled; }
+    bool multiDrawEnabled() const { return multiDraw; }
+
+    // whether the context can issue the multi draws, the command list is looped otherwise
+    static bool multiDrawIndirectSupported()
+    {
+        return GLAD_GL_ARB_multi_draw_indirect && GLAD_GL_ARB_draw_indirect && GLAD_GL_ARB_base_instance;
+    }
+
+    // sorts and draws everything submitted since begin
+    void execute()
+    {
+        cull();
+        submissionOrder.resize(items.size());
+        for (size_t i = 0; i < items.size(); i++)
+            submissionOrder[i] = (uint32_t)i;
+        stats.submitted += walk(submissionOrder, false);
+        stats.draws += items.size();
+        // what sorting alone saves is counted before any draws are merged
+        sort();
+        stats.sorted += walk(order, false);
+
+        indirect = multiDraw && multiDrawIndirectSupported();
+        if (mergeInstances())
+            sort();
+        if (indirect && !commands.empty())
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        stats.merged += walk(order, true);
+        if (indirect && !commands.empty())
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        stats.frames++;
+    }
+
+    const RenderQueueStats &statistics() const { return stats; }
+
+private:
+    static const unsigned int MAX_TEXTURE_UNITS = 16;
+    static const unsigned int RADIX_BITS = 8;
+    static const unsigned int RADIX = 1u << RADIX_BITS;
+    static const unsigned int UNKNOWN = ~0u;
+    static const uint32_t NO_GROUP = ~0u;
+
+    // per instance data, the normal matrix columns are padded to vec4
+    struct InstanceData {
+        glm::mat4 model;
+        glm::vec4 normal[3];
+    };
+
+    // what has to be equal for draws to be merged into one instanced draw. With multi draw, batches of commands
+    // are found by the same key with the geometry left out.
+    struct InstanceKey {
+        const Shader *shader;
+        const Material *material;
+        unsigned int pass;
+        unsigned int vao;
+        GLenum indexType;
+        GLsizei count;
+        size_t first;
+        GLint baseVertex;
+
+        bool operator==(const InstanceKey &other) const
+        {
+            return shader == other.shader && material == other.material && pass == other.pass && vao == other.vao
+                && indexType == other.indexType && count == other.count && first == other.first
+                && baseVertex == other.baseVertex;
+        }
+    };
+
+    struct InstanceKeyHash {
+        size_t operator()(const InstanceKey &key) const
+        {
+            size_t hash = std::hash<const void *>()(key.shader);
+            for (size_t value : {(size_t)key.material, (size_t)key.pass, (size_t)key.vao, (size_t)key.indexType,
+                                 (size_t)key.count, key.first, (size_t)key.baseVertex})
+                hash = hash * 31 + value;
+            return hash;
+        }
+    };
+
+    glm::vec3 viewPosition = glm::vec3(0.0f);
+    std::vector<DrawItem> items;
+    // bounds of the items submitted with them, boundedItems[i] is the item of box i
+    FrustumCuller culler;
+    std::vector<uint32_t> boundedItems;
+    Frustum frustum;
+    bool culling = false;
+    // sort buffers, kept from frame to frame
+    std::vector<uint64_t> keys, scratchKeys;
+    std::vector<uint32_t> order, scratchOrder, submissionOrder;
+    // instancing buffers, kept from frame to frame as well. Every command is one geometry, every batch the
+    // commands drawn by one merged item.
+    std::unordered_map<InstanceKey, uint32_t, InstanceKeyHash> commandGroups, batchGroups;
+    std::vector<uint32_t> commandOf, commandSizes, commandBatch, commandSlot, commandFill;
+    std::vector<uint32_t> batchItems, batchCommands, batchFirst, batchFill, batchItem;
+    std::vector<DrawItem> merged;
+    std::vector<InstanceData> instances;
+    std::vector<IndirectCommand> commands;
+    GLuint instanceBuffer = 0;
+    GLuint indirectBuffer = 0;
+    // vertex arrays whose instance attributes are enabled
+    std::vector<unsigned int> instancedVertexArrays;
+    bool multiDraw = false;
+    bool indirect = false;  // multi draw on and supported, for the frame being executed
+    RenderQueueStats stats;
+
+    // pass 4 bits | program 12 | material 16 | vertex array 12 | distance 20
+    static uint64_t sortKey(const DrawItem &item, float distance)
+    {
+        uint64_t material = item.material && !item.material->textures.empty() ? item.material->textures[0] : 0;
+        // the bits of a positive float order like the float, the top 20 below the sign keep a relative
+        // precision of 2^-9
+        uint32_t depth;
+        distance = distance > 0.0f ? distance : 0.0f;
+        memcpy(&depth, &distance, sizeof(depth));
+        return (uint64_t)(item.pass & 0xF) << 60
+             | (uint64_t)(item.shader->ID & 0xFFF) << 48
+             | (material & 0xFFFF) << 32
+             | (uint64_t)(item.vao & 0xFFF) << 20
+             | (uint64_t)(depth >> 11);
+    }
+
+    static GLuint indexSize(GLenum indexType)
+    {
+        return indexType == GL_UNSIGNED_SHORT ? 2 : indexType == GL_UNSIGNED_BYTE ? 1 : 4;
+    }
+
+    // replaces the items that have an instanced program and can be drawn together by one item per batch, drawn at
+    // the distance of the nearest instance, and uploads their transforms and commands. Without multi draw a batch
+    // is one geometry with the same state, with it every indexed geometry with the same program, material and
+    // vertex array. Returns whether any items were merged.
+    bool mergeInstances()
+    {
+        commands.clear();
+        commandGroups.clear();
+        batchGroups.clear();
+        commandSizes.clear();
+        commandBatch.clear();
+        batchItems.clear();
+        batchCommands.clear();
+        commandOf.assign(items.size(), uint32_t(NO_GROUP));
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            const DrawItem &item = items[i];
+            if (!item.instancedShader || !item.transform)
+                continue;
+            InstanceKey key = {item.instancedShader, item.material, item.pass, item.vao, item.indexType, item.count,
+                               item.first, item.baseVertex};
+            auto command = commandGroups.emplace(key, (uint32_t)commandSizes.size());
+            if (command.second)
+            {
+                // the commands of a multi draw share the index type, draws without indices are not batched
+                if (multiDraw && item.indexType)
+                    key.count = key.first = key.baseVertex = 0;
+                auto batch = batchGroups.emplace(key, (uint32_t)batchItems.size());
+                if (batch.second)
+                {
+                    batchItems.push_back(0);
+                    batchCommands.push_back(0);
+                }
+                commandSizes.push_back(0);
+                commandBatch.push_back(batch.first->second);
+                batchCommands[batch.first->second]++;
+            }
+            commandOf[i] = command.first->second;
+            commandSizes[commandOf[i]]++;
+            batchItems[commandBatch[commandOf[i]]]++;
+        }
+
+        // a batch of a single placement keeps the plain program and its uniforms. The commands of a batch follow
+        // each other, and the instances of a command.
+        size_t commandTotal = 0;
+        batchFirst.assign(batchItems.size(), 0);
+        for (size_t batch = 0; batch < batchItems.size(); batch++)
+            if (batchItems[batch] > 1)
+            {
+                batchFirst[batch] = (uint32_t)commandTotal;
+                commandTotal += batchCommands[batch];
+            }
+        if (commandTotal == 0)
+            return false;
+
+        commands.resize(commandTotal);
+        batchFill.assign(batchItems.size(), 0);
+        commandSlot.assign(commandSizes.size(), uint32_t(NO_GROUP));
+        for (size_t command = 0; command < commandSizes.size(); command++)
+        {
+            uint32_t batch = commandBatch[command];
+            if (batchItems[batch] > 1)
+                commandSlot[command] = batchFirst[batch] + batchFill[batch]++;
+        }
+        commandFill.assign(commandSizes.size(), 0);
+        size_t instanceTotal = 0;
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            uint32_t command = commandOf[i];
+            if (command == NO_GROUP || commandSlot[command] == NO_GROUP || commandFill[command]++)
+                continue;
+            const DrawItem &item = items[i];
+            IndirectCommand &slot = commands[commandSlot[command]];
+            slot.count = (GLuint)item.count;
+            slot.instanceCount = commandSizes[command];
+            // the first vertex for draws without indices
+            slot.firstIndex = (GLuint)(item.indexType ? item.first / indexSize(item.indexType) : item.first);
+            slot.baseVertex = item.baseVertex;
+            slot.baseInstance = (GLuint)instanceTotal;
+            instanceTotal += commandSizes[command];
+        }
+
+        instances.resize(instanceTotal);
+        commandFill.assign(commandSizes.size(), 0);
+        batchItem.assign(batchItems.size(), uint32_t(NO_GROUP));
+        merged.clear();
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            const DrawItem &item = items[i];
+            uint32_t command = commandOf[i];
+            if (command == NO_GROUP || commandSlot[command] == NO_GROUP)
+            {
+                merged.push_back(item);
+                continue;
+            }
+            // the geometry of a batch can differ in its dequantization, it goes into the model matrix. Normals
+            // are not quantized with the positions, the normal matrix stays.
+            InstanceData &instance = instances[commands[commandSlot[command]].baseInstance + commandFill[command]++];
+            instance.model = glm::scale(glm::translate(item.transform->model(), item.positionOffset), item.positionScale);
+            for (int column = 0; column < 3; column++)
+                instance.normal[column] = glm::vec4(item.transform->normal()[column], 0.0f);
+
+            uint32_t batch = commandBatch[command];
+            if (batchItem[batch] == NO_GROUP)
+            {
+                batchItem[batch] = (uint32_t)merged.size();
+                merged.push_back(item);
+                DrawItem &instanced = merged.back();
+                instanced.shader = item.instancedShader;
+                instanced.transform = nullptr;
+                instanced.positionScale = glm::vec3(1.0f);
+                instanced.positionOffset = glm::vec3(0.0f);
+                instanced.commandCount = (GLsizei)batchCommands[batch];
+                instanced.firstCommand = batchFirst[batch];
+            }
+            DrawItem &instanced = merged[batchItem[batch]];
+            instanced.distance = std::min(instanced.distance, item.distance);
+            instanced.key = sortKey(instanced, instanced.distance);
+        }
+        items.swap(merged);
+
+        if (!instanceBuffer)
+            glGenBuffers(1, &instanceBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(InstanceData), instances.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        if (!indirect)
+            return true;
+        if (!indirectBuffer)
+            glGenBuffers(1, &indirectBuffer);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(IndirectCommand), commands.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        return true;
+    }
+
+    // drops the items whose bounds are outside the frustum
+    void cull()
+    {
+        if (!culling || boundedItems.empty())
+            return;
+        culler.cull(frustum);
+        size_t box = 0, kept = 0;
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            bool bounded = box < boundedItems.size() && boundedItems[box] == i;
+            if (bounded && !culler.visible(box++))
+                continue;
+            if (kept != i)
+                items[kept] = items[i];
+            kept++;
+        }
+        stats.culled += items.size() - kept;
+        items.resize(kept);
+    }
+
+    // points the instance attributes of the bound vertex array at the transforms from firstInstance on
+    void bindInstances(unsigned int vao, size_t firstInstance)
+    {
+        bool enabled = false;
+        for (unsigned int vertexArray : instancedVertexArrays)
+            enabled = enabled || vertexArray == vao;
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        size_t offset = firstInstance * sizeof(InstanceData);
+        for (unsigned int column = 0; column < 4; column++)
+        {
+            GLuint location = INSTANCE_MODEL_ATTRIBUTE + column;
+            glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                                  (void*)(offset + offsetof(InstanceData, model) + column * sizeof(glm::vec4)));
+            if (!enabled)
+            {
+                glEnableVertexAttribArray(location);
+                glVertexAttribDivisor(location, 1);
+            }
+        }
+        for (unsigned int column = 0; column < 3; column++)
+        {
+            GLuint location = INSTANCE_NORMAL_ATTRIBUTE + column;
+            glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                                  (void*)(offset + offsetof(InstanceData, normal) + column * sizeof(glm::vec4)));
+            if (!enabled)
+            {
+                glEnableVertexAttribArray(location);
+                glVertexAttribDivisor(location, 1);
+            }
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        if (!enabled)
+            instancedVertexArrays.push_back(vao);
+    }
+
+    // draws the commands of a merged item, as one multi draw when possible
+    void drawCommands(const DrawItem &item)
+    {
+        stats.commands += item.commandCount;
+        if (indirect && item.indexType)
+        {
+            // the base instance of every command selects its transforms
+            bindInstances(item.vao, 0);
+            glMultiDrawElementsIndirect(GL_TRIANGLES, item.indexType, (void*)(item.firstCommand * sizeof(IndirectCommand)),
+                                        item.commandCount, 0);
+            stats.drawCalls++;
+            return;
+        }
+        // without base instances the attributes are pointed at the transforms of every command
+        for (size_t i = item.firstCommand; i < item.firstCommand + item.commandCount; i++)
+        {
+            const IndirectCommand &command = commands[i];
+            bindInstances(item.vao, command.baseInstance);
+            if (item.indexType)
+                glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.count, item.indexType,
+                                                  (void*)((size_t)command.firstIndex * indexSize(item.indexType)),
+                                                  command.instanceCount, command.baseVertex);
+            else
+                glDrawArraysInstanced(GL_TRIANGLES, command.firstIndex, command.count, command.instanceCount);
+            stats.drawCalls++;
+        }
+    }
+
+    // sorts the item indices into order by key, skipping the digits all keys have in common
+    void sort()
+    {
+        size_t count = items.size();
+        keys.resize(count);
+        order.resize(count);
+        scratchKeys.resize(count);
+        scratchOrder.resize(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            keys[i] = items[i].key;
+            order[i] = (uint32_t)i;
+        }
+        if (count < 2)
+            return;
+
+        for (unsigned int shift = 0; shift < 64; shift += RADIX_BITS)
+        {
+            size_t histogram[RADIX] = {};
+            for (size_t i = 0; i < count; i++)
+                histogram[(keys[i] >> shift) & (RADIX - 1)]++;
+            if (histogram[(keys[0] >> shift) & (RADIX - 1)] == count)
+                continue;
+
+            size_t offset = 0;
+            for (unsigned int digit = 0; digit < RADIX; digit++)
+            {
+                size_t digitCount = histogram[digit];
+                histogram[digit] = offset;
+                offset += digitCount;
+            }
+            for (size_t i = 0; i < count; i++)
+            {
+                size_t to = histogram[(keys[i] >> shift) & (RADIX - 1)]++;
+                scratchKeys[to] = keys[i];
+                scratchOrder[to] = order[i];
+            }
+            keys.swap(scratchKeys);
+            order.swap(scratchOrder);
+        }
+    }
+
+    // goes through the items in sequence, binding only what changed. Without issue nothing is sent to GL and only
+    // the state changes are counted.
+    RenderStateChanges walk(const std::vector<uint32_t> &sequence, bool issue)
+    {
+        DrawUniforms &drawUniforms = DrawUniforms::instance();
+        RenderStateChanges changes;
+        Shader *program = nullptr;
+        DrawUniforms::Program *uniforms = nullptr;
+        const Material *material = nullptr;
+        unsigned int vertexArray = UNKNOWN;
+        unsigned int textures[MAX_TEXTURE_UNITS];
+        for (unsigned int &texture : textures)
+            texture = UNKNOWN;
+
+        for (uint32_t index : sequence)
+        {
+            const DrawItem &item = items[index];
+            bool programChanged = item.shader != program;
+            if (programChanged)
+            {
+                program = item.shader;
+                changes.programs++;
+                if (issue)
+                {
+                    program->use();
+                    uniforms = &drawUniforms.program(*program);
+                }
+            }
+            if (item.vao != vertexArray)
+            {
+                vertexArray = item.vao;
+                changes.vertexArrays++;
+                if (issue)
+                    GLState::instance().bindVertexArray(vertexArray);
+            }
+            if (item.material)
+            {
+                // the samplers are per program, they need setting again after switching programs
+                bool setSamplers = issue && (programChanged || item.material != material);
+                material = item.material;
+                const std::vector<UniformHandle> *samplers =
+                    setSamplers ? &drawUniforms.samplers(*program, *uniforms, *material) : nullptr;
+                for (unsigned int unit = 0; unit < material->textures.size() && unit < MAX_TEXTURE_UNITS; unit++)
+                {
+                    if (samplers && unit < samplers->size() && !material->samplers[unit].empty())
+                        program->setInt((*samplers)[unit], (int)unit);
+                    if (textures[unit] == material->textures[unit])
+                        continue;
+                    textures[unit] = material->textures[unit];
+                    changes.textures++;
+                    if (issue)
+                        GLState::instance().bindTexture(unit, GL_TEXTURE_2D, textures[unit]);
+                }
+            }
+            if (!issue)
+                continue;
+
+            if (item.transform)
+                setTransform(*program, item.transformUniforms, *item.transform);
+            program->setVec3(uniforms->positionScale, item.positionScale);
+            program->setVec3(uniforms->positionOffset, item.positionOffset);
+            if (item.commandCount)
+            {
+                drawCommands(item);
+                continue;
+            }
+            if (item.indexType)
+                glDrawElementsBaseVertex(GL_TRIANGLES, item.count, item.indexType, (void*)item.first, item.baseVertex);
+            else
+                glDrawArrays(GL_TRIANGLES, (GLint)item.first, item.count);
+            stats.drawCalls++;
+        }
+        return changes;
+    }
+};
+#endif
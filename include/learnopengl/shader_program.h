@@ -0,0 +1,442 @@
+#ifndef SHADER_PROGRAM_H
+#define SHADER_PROGRAM_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <common.h>
+#include <uniform_locations.h>
+#include <learnopengl/program_cache.h>
+#include <learnopengl/gl_state.h>
+
+// The program building, reloading and uniform setting shared by the Shader classes of shader.h and shader_m.h,
+// which only differ in their constructors.
+class ShaderProgram
+{
+public:
+    unsigned int ID;
+    // lets the driver use as many threads as it likes for the builds (KHR_parallel_shader_compile), call once
+    // after loading GL
+    // ------------------------------------------------------------------------
+    static void enableParallelCompile()
+    {
+        if (GLAD_GL_KHR_parallel_shader_compile)
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    }
+    // whether finish would return without waiting for the compiler. Without KHR_parallel_shader_compile the
+    // driver cannot be asked and a pending build is reported as ready.
+    // ------------------------------------------------------------------------
+    bool ready() const
+    {
+        return !pending || completed(ID);
+    }
+    // waits for the submitted build, reports errors, stores the binary and reads the uniforms
+    // ------------------------------------------------------------------------
+    void finish()
+    {
+        if (!pending)
+            return;
+        pending = false;
+        complete(build);
+        uniforms.reflect(ID);
+    }
+    // whether the program is built from the given file, directly or through an #include
+    // ------------------------------------------------------------------------
+    bool dependsOn(const std::string &path) const
+    {
+        for (const std::string &file : files)
+            if (file == path)
+                return true;
+        return false;
+    }
+    // starts rebuilding the program from its files, the current program stays in use until swapReloaded finds
+    // the new one linked. A reload that is still compiling is dropped in favour of the new one.
+    // ------------------------------------------------------------------------
+    void reload()
+    {
+        finish();
+        if (reloading)
+            discard(reloadBuild);
+        submit(reloadBuild);
+        reloading = true;
+    }
+    // replaces the program by the reloaded one once the driver is done with it and it linked, carrying over the
+    // uniform values and block bindings. Returns whether the program changed.
+    // ------------------------------------------------------------------------
+    bool swapReloaded()
+    {
+        if (!reloading || !completed(reloadBuild.program))
+            return false;
+        reloading = false;
+        if (!complete(reloadBuild))
+        {
+            std::cout << "ERROR::SHADER::RELOAD_FAILED " << vertexFile << " + " << fragmentFile << ", keeping the previous program" << std::endl;
+            glDeleteProgram(reloadBuild.program);
+            return false;
+        }
+        copyUniformState(ID, reloadBuild.program);
+        glDeleteProgram(ID);
+        ID = reloadBuild.program;
+        uniforms.reflect(ID);
+        std::cout << "SHADER:: reloaded " << vertexFile << " + " << fragmentFile << std::endl;
+        return true;
+    }
+    // activate the shader
+    // ------------------------------------------------------------------------
+    void use()
+    {
+        finish();
+        GLState::instance().useProgram(ID);
+    }
+    // connects a uniform block of the program to a binding point, blocks the program does not use are skipped
+    // ------------------------------------------------------------------------
+    void bindUniformBlock(const std::string &name, unsigned int binding)
+    {
+        finish();
+        GLuint index = glGetUniformBlockIndex(ID, name.c_str());
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, binding);
+    }
+    // utility uniform functions
+    // ------------------------------------------------------------------------
+    void setBool(const std::string &name, bool value) const
+    {
+        uniforms.set(uniforms.location(name), (GLint)value, glUniform1i);
+    }
+    // ------------------------------------------------------------------------
+    void setInt(const std::string &name, int value) const
+    {
+        uniforms.set(uniforms.location(name), value, glUniform1i);
+    }
+    // ------------------------------------------------------------------------
+    void setFloat(const std::string &name, float value) const
+    {
+        uniforms.set(uniforms.location(name), value, glUniform1f);
+    }
+    // ------------------------------------------------------------------------
+    void setVec2(const std::string &name, const glm::vec2 &value) const
+    {
+        uniforms.set(uniforms.location(name), value, glUniform2fv);
+    }
+    void setVec2(const std::string &name, float x, float y) const
+    {
+        setVec2(name, glm::vec2(x, y));
+    }
+    // ------------------------------------------------------------------------
+    void setVec3(const std::string &name, const glm::vec3 &value) const
+    {
+        uniforms.set(uniforms.location(name), value, glUniform3fv);
+    }
+    void setVec3(const std::string &name, float x, float y, float z) const
+    {
+        setVec3(name, glm::vec3(x, y, z));
+    }
+    // ------------------------------------------------------------------------
+    void setVec4(const std::string &name, const glm::vec4 &value) const
+    {
+        uniforms.set(uniforms.location(name), value, glUniform4fv);
+    }
+    void setVec4(const std::string &name, float x, float y, float z, float w) const
+    {
+        setVec4(name, glm::vec4(x, y, z, w));
+    }
+    // ------------------------------------------------------------------------
+    void setMat2(const std::string &name, const glm::mat2 &mat) const
+    {
+        uniforms.set(uniforms.location(name), mat, glUniformMatrix2fv);
+    }
+    // ------------------------------------------------------------------------
+    void setMat3(const std::string &name, const glm::mat3 &mat) const
+    {
+        uniforms.set(uniforms.location(name), mat, glUniformMatrix3fv);
+    }
+    // ------------------------------------------------------------------------
+    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    {
+        uniforms.set(uniforms.location(name), mat, glUniformMatrix4fv);
+    }
+
+    // uniform uploads issued and skipped as redundant for this program, uniformUploadStats() sums all programs
+    // ------------------------------------------------------------------------
+    const UniformUploadStats &uploadStats() const
+    {
+        return uniforms.uploadStats();
+    }
+
+    // handle based uniform functions, setting a uniform through its handle skips the name lookup
+    // ------------------------------------------------------------------------
+    UniformHandle uniform(const std::string &name)
+    {
+        finish();
+        return uniforms.handle(name);
+    }
+    // ------------------------------------------------------------------------
+    void setBool(UniformHandle uniform, bool value) const
+    {
+        uniforms.set(uniforms.location(uniform), (GLint)value, glUniform1i);
+    }
+    // ------------------------------------------------------------------------
+    void setInt(UniformHandle uniform, int value) const
+    {
+        uniforms.set(uniforms.location(uniform), value, glUniform1i);
+    }
+    // ------------------------------------------------------------------------
+    void setFloat(UniformHandle uniform, float value) const
+    {
+        uniforms.set(uniforms.location(uniform), value, glUniform1f);
+    }
+    // ------------------------------------------------------------------------
+    void setVec2(UniformHandle uniform, const glm::vec2 &value) const
+    {
+        uniforms.set(uniforms.location(uniform), value, glUniform2fv);
+    }
+    // ------------------------------------------------------------------------
+    void setVec3(UniformHandle uniform, const glm::vec3 &value) const
+    {
+        uniforms.set(uniforms.location(uniform), value, glUniform3fv);
+    }
+    // ------------------------------------------------------------------------
+    void setVec4(UniformHandle uniform, const glm::vec4 &value) const
+    {
+        uniforms.set(uniforms.location(uniform), value, glUniform4fv);
+    }
+    // ------------------------------------------------------------------------
+    void setMat2(UniformHandle uniform, const glm::mat2 &mat) const
+    {
+        uniforms.set(uniforms.location(uniform), mat, glUniformMatrix2fv);
+    }
+    // ------------------------------------------------------------------------
+    void setMat3(UniformHandle uniform, const glm::mat3 &mat) const
+    {
+        uniforms.set(uniforms.location(uniform), mat, glUniformMatrix3fv);
+    }
+    // ------------------------------------------------------------------------
+    void setMat4(UniformHandle uniform, const glm::mat4 &mat) const
+    {
+        uniforms.set(uniforms.location(uniform), mat, glUniformMatrix4fv);
+    }
+
+protected:
+    // submits the build without waiting for it. The result is checked on first use (see finish), so the driver
+    // can compile all programs concurrently while the rest of the scene loads. geometryPath may be null,
+    // defines select a permutation of the sources (see preprocessShader).
+    // ------------------------------------------------------------------------
+    ShaderProgram(const char* vertexPath, const char* fragmentPath, const char* geometryPath,
+                  const std::vector<std::string> &defines)
+        : vertexFile(vertexPath), fragmentFile(fragmentPath), defines(defines)
+    {
+        appendShaderFolderIfNotPresent(vertexFile);
+        appendShaderFolderIfNotPresent(fragmentFile);
+        if (geometryPath != nullptr)
+        {
+            geometryFile = geometryPath;
+            appendShaderFolderIfNotPresent(geometryFile);
+        }
+        submit(build);
+        ID = build.program;
+        pending = true;
+    }
+
+private:
+    // a shader stage of a pending build, the source is kept in case a cached binary is rejected
+    struct Stage {
+        GLenum type;
+        std::string name;
+        std::string code;
+        unsigned int shader;
+    };
+
+    // a program being built, see submit and complete
+    struct Build {
+        unsigned int program = 0;
+        std::vector<Stage> stages;
+        ProgramCache cache;
+        bool fromBinary = false;
+    };
+
+    UniformLocations uniforms;
+    std::string vertexFile;
+    std::string fragmentFile;
+    std::string geometryFile;  // empty without a geometry shader
+    std::vector<std::string> defines;
+    // the files the program was last built from, including the resolved #includes
+    std::vector<std::string> files;
+    Build build;
+    Build reloadBuild;
+    bool pending = false;
+    bool reloading = false;
+
+    // reads the sources and submits a new program, reusing the binary linked on an earlier launch if there is one
+    // ------------------------------------------------------------------------
+    void submit(Build &target)
+    {
+        // 1. retrieve the vertex/fragment source code from filePath
+        std::string vertexCode;
+        std::string fragmentCode;
+        std::string geometryCode;
+        std::ifstream vShaderFile;
+        std::ifstream fShaderFile;
+        std::ifstream gShaderFile;
+        // ensure ifstream objects can throw exceptions:
+        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
+        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
+        gShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
+        try
+        {
+            // open files
+            vShaderFile.open(vertexFile);
+            fShaderFile.open(fragmentFile);
+            std::stringstream vShaderStream, fShaderStream;
+            // read file's buffer contents into streams
+            vShaderStream << vShaderFile.rdbuf();
+            fShaderStream << fShaderFile.rdbuf();
+            // close file handlers
+            vShaderFile.close();
+            fShaderFile.close();
+            // convert stream into string
+            vertexCode = vShaderStream.str();
+            fragmentCode = fShaderStream.str();
+            // if geometry shader path is present, also load a geometry shader
+            if(!geometryFile.empty())
+            {
+                gShaderFile.open(geometryFile);
+                std::stringstream gShaderStream;
+                gShaderStream << gShaderFile.rdbuf();
+                gShaderFile.close();
+                geometryCode = gShaderStream.str();
+            }
+        }
+        catch (std::ifstream::failure& e)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+        }
+        // resolve #include lines and add the defines of this permutation
+        files = {vertexFile, fragmentFile};
+        vertexCode = preprocessShader(vertexFile, vertexCode, defines, &files);
+        fragmentCode = preprocessShader(fragmentFile, fragmentCode, defines, &files);
+        if(!geometryFile.empty())
+        {
+            files.push_back(geometryFile);
+            geometryCode = preprocessShader(geometryFile, geometryCode, defines, &files);
+        }
+        // 2. submit the program
+        target.program = glCreateProgram();
+        target.stages.clear();
+        target.stages.push_back({GL_VERTEX_SHADER, "VERTEX", vertexCode, 0});
+        target.stages.push_back({GL_FRAGMENT_SHADER, "FRAGMENT", fragmentCode, 0});
+        std::string cacheName = programCacheName(vertexFile) + '+' + programCacheName(fragmentFile);
+        if(!geometryFile.empty())
+        {
+            target.stages.push_back({GL_GEOMETRY_SHADER, "GEOMETRY", geometryCode, 0});
+            cacheName += '+' + programCacheName(geometryFile);
+        }
+        for (const std::string &define : defines)
+            cacheName += '+' + define.substr(0, define.find(' '));
+        target.cache = ProgramCache(cacheName, {&vertexCode, &fragmentCode, &geometryCode});
+        // complete falls back to the sources when the driver rejects the binary
+        target.fromBinary = target.cache.load(target.program);
+        if (!target.fromBinary)
+            submitSource(target);
+    }
+
+    // 3. compile shaders and link the program, without asking for the results
+    // ------------------------------------------------------------------------
+    void submitSource(Build &target)
+    {
+        for (Stage &stage : target.stages)
+        {
+            const char *code = stage.code.c_str();
+            stage.shader = glCreateShader(stage.type);
+            glShaderSource(stage.shader, 1, &code, NULL);
+            glCompileShader(stage.shader);
+            glAttachShader(target.program, stage.shader);
+        }
+        target.cache.prepare(target.program);
+        glLinkProgram(target.program);
+    }
+
+    // waits for a submitted build, reports errors and stores the binary. Returns whether the program linked.
+    // ------------------------------------------------------------------------
+    bool complete(Build &target)
+    {
+        GLint linked = 0;
+        glGetProgramiv(target.program, GL_LINK_STATUS, &linked);
+        if (target.fromBinary && !linked)
+        {
+            std::cout << "PROGRAM_CACHE:: driver rejected " << target.cache.path() << ", compiling from source" << std::endl;
+            target.fromBinary = false;
+            submitSource(target);
+        }
+        if (!target.fromBinary)
+        {
+            for (const Stage &stage : target.stages)
+                checkCompileErrors(stage.shader, stage.name);
+            checkCompileErrors(target.program, "PROGRAM");
+            glGetProgramiv(target.program, GL_LINK_STATUS, &linked);
+            target.cache.store(target.program);
+            // delete the shaders as they're linked into our program now and no longer necessery
+            for (const Stage &stage : target.stages)
+            {
+                glDetachShader(target.program, stage.shader);
+                glDeleteShader(stage.shader);
+            }
+        }
+        target.stages.clear();
+        return linked != 0;
+    }
+
+    // drops a build that was not completed
+    // ------------------------------------------------------------------------
+    void discard(Build &target)
+    {
+        for (const Stage &stage : target.stages)
+            if (stage.shader)
+                glDeleteShader(stage.shader);
+        target.stages.clear();
+        glDeleteProgram(target.program);
+        target.program = 0;
+    }
+
+    // whether the driver finished building program, always true without KHR_parallel_shader_compile
+    // ------------------------------------------------------------------------
+    static bool completed(unsigned int program)
+    {
+        if (!GLAD_GL_KHR_parallel_shader_compile)
+            return true;
+        GLint completed = 0;
+        glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &completed);
+        return completed != 0;
+    }
+
+    // utility function for checking shader compilation/linking errors.
+    // ------------------------------------------------------------------------
+    void checkCompileErrors(GLuint shader, std::string type)
+    {
+        GLint success;
+        GLchar infoLog[1024];
+        if (type != "PROGRAM")
+        {
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+            if (!success)
+            {
+                glGetShaderInfoLog(shader, 1024, NULL, infoLog);
+                std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+            }
+        }
+        else
+        {
+            glGetProgramiv(shader, GL_LINK_STATUS, &success);
+            if (!success)
+            {
+                glGetProgramInfoLog(shader, 1024, NULL, infoLog);
+                std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+            }
+        }
+    }
+};
+#endif
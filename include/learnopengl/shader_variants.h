@@ -0,0 +1,77 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <learnopengl/shader_m.h>
+
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+// all permutations of a shader over a set of on/off options. Every option is a define, variant i is built with the
+// options whose bit is set in i. The variants are submitted together when the object is created, so they compile
+// concurrently and toggling an option later only picks another program instead of branching in every fragment.
+class ShaderVariants {
+public:
+    ShaderVariants(const char *vertexPath, const char *fragmentPath, const std::vector<std::string> &options)
+    {
+        unsigned int count = 1u << options.size();
+        variants.reserve(count);
+        for (unsigned int mask = 0; mask < count; mask++)
+        {
+            std::vector<std::string> defines;
+            for (size_t option = 0; option < options.size(); option++)
+                if (mask & (1u << option))
+                    defines.push_back(options[option]);
+            variants.emplace_back(vertexPath, fragmentPath, defines);
+        }
+    }
+
+    // the variant with the given options enabled, in the order they were passed to the constructor
+    Shader &variant(std::initializer_list<bool> enabled)
+    {
+        unsigned int mask = 0, bit = 0;
+        for (bool option : enabled)
+            mask |= (option ? 1u : 0u) << bit++;
+        return variants[mask];
+    }
+
+    // handles are created on every variant in the same order, so the handle is valid on all of them
+    UniformHandle uniform(const std::string &name)
+    {
+        UniformHandle handle = {0};
+        for (Shader &shader : variants)
+            handle = shader.uniform(name);
+        return handle;
+    }
+
+    // starts rebuilding the variants built from any of the changed files, see Shader::reload
+    void reload(const std::vector<std::string> &changed)
+    {
+        for (Shader &shader : variants)
+            for (const std::string &path : changed)
+                if (shader.dependsOn(path))
+                {
+                    shader.reload();
+                    break;
+                }
+    }
+
+    // swaps in the rebuilt variants that are done, see Shader::swapReloaded. Returns one of the swapped variants,
+    // nullptr when none changed.
+    Shader *swapReloaded()
+    {
+        Shader *swapped = nullptr;
+        for (Shader &shader : variants)
+            if (shader.swapReloaded())
+                swapped = &shader;
+        return swapped;
+    }
+
+    // for settings that apply to every variant
+    std::vector<Shader>::iterator begin() { return variants.begin(); }
+    std::vector<Shader>::iterator end() { return variants.end(); }
+
+private:
+    std::vector<Shader> variants;
+};
+#endif
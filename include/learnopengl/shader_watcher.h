@@ -0,0 +1,110 @@
+#ifndef SHADER_WATCHER_H
+#define SHADER_WATCHER_H
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include <dirent.h>
+#include <errno.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Watches a shader directory and its subdirectories for written files with inotify, for hot reloading.
+//
+// The descriptor is non-blocking and polled once per frame, so no thread is needed and a frame without changes
+// costs one read system call. Both in-place writes and the write-aside-and-rename most editors do are reported.
+class ShaderWatcher {
+public:
+    explicit ShaderWatcher(const std::string &directory)
+    {
+        fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd < 0)
+        {
+            std::cout << "ERROR::SHADER_WATCHER:: inotify is not available, shaders will not be reloaded" << std::endl;
+            return;
+        }
+        watch(directory);
+        if (DIR *dir = opendir(directory.c_str()))
+        {
+            while (dirent *entry = readdir(dir))
+            {
+                if (entry->d_name[0] == '.')
+                    continue;
+                std::string path = directory + '/' + entry->d_name;
+                // some file systems do not report the type, stat tells then
+                struct stat status;
+                if (entry->d_type == DT_DIR || (entry->d_type == DT_UNKNOWN && stat(path.c_str(), &status) == 0 && S_ISDIR(status.st_mode)))
+                    watch(path);
+            }
+            closedir(dir);
+        }
+    }
+
+    ShaderWatcher(const ShaderWatcher &) = delete;
+    ShaderWatcher &operator=(const ShaderWatcher &) = delete;
+
+    ~ShaderWatcher()
+    {
+        if (fd >= 0)
+            close(fd);
+    }
+
+    // paths (directory/name) of the files written since the last call, each reported once
+    std::vector<std::string> changes()
+    {
+        std::vector<std::string> changed;
+        if (fd < 0)
+            return changed;
+
+        alignas(inotify_event) char buffer[4096];
+        for (;;)
+        {
+            ssize_t length = read(fd, buffer, sizeof(buffer));
+            if (length <= 0)
+            {
+                if (length < 0 && errno != EAGAIN && errno != EINTR)
+                    std::cout << "ERROR::SHADER_WATCHER:: reading events failed" << std::endl;
+                break;
+            }
+            for (ssize_t offset = 0; offset < length;)
+            {
+                const inotify_event *event = reinterpret_cast<const inotify_event *>(buffer + offset);
+                offset += sizeof(inotify_event) + event->len;
+                if (event->len == 0 || (event->mask & IN_ISDIR))
+                    continue;
+                for (const Watch &watched : watches)
+                    if (watched.descriptor == event->wd)
+                    {
+                        std::string path = watched.directory + '/' + event->name;
+                        bool seen = false;
+                        for (const std::string &other : changed)
+                            seen = seen || other == path;
+                        if (!seen)
+                            changed.push_back(path);
+                    }
+            }
+        }
+        return changed;
+    }
+
+private:
+    struct Watch {
+        int descriptor;
+        std::string directory;
+    };
+
+    int fd = -1;
+    std::vector<Watch> watches;
+
+    void watch(const std::string &directory)
+    {
+        int descriptor = inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (descriptor < 0)
+            std::cout << "ERROR::SHADER_WATCHER:: could not watch " << directory << std::endl;
+        else
+            watches.push_back({descriptor, directory});
+    }
+};
+#endif
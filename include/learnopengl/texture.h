@@ -0,0 +1,167 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/thread_pool.h>
+
+#include <climits>
+#include <cstdlib>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <iostream>
+
+// pixels of an image file decoded by stb_image. Decoding does not touch OpenGL, so it can run on a worker thread;
+// the upload to a texture object has to happen on the thread owning the GL context.
+struct TextureImage {
+    int width = 0;
+    int height = 0;
+    int nrComponents = 0;
+    std::unique_ptr<unsigned char, void (*)(void *)> data{nullptr, stbi_image_free};
+};
+
+inline TextureImage decodeTextureImage(const std::string &filename)
+{
+    TextureImage image;
+    image.data.reset(stbi_load(filename.c_str(), &image.width, &image.height, &image.nrComponents, 0));
+    return image;
+}
+
+// creates a mipmapped, repeating 2D texture from a decoded image
+inline unsigned int uploadTextureImage(const TextureImage &image, const std::string &path)
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+
+    if (image.data)
+    {
+        GLenum format = GL_RGB;
+        if (image.nrComponents == 1)
+            format = GL_RED;
+        else if (image.nrComponents == 3)
+            format = GL_RGB;
+        else if (image.nrComponents == 4)
+            format = GL_RGBA;
+
+        GLState::instance().bindTextureForEdit(0, GL_TEXTURE_2D, textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.data.get());
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+    else
+    {
+        std::cout << "Texture failed to load at path: " << path << std::endl;
+    }
+
+    return textureID;
+}
+
+// Process wide cache of 2D textures shared by all models and the scene code.
+//
+// Textures are keyed by their canonical file path, so the same image referenced by several models (or through
+// different relative paths) is decoded and uploaded once. Every acquire hands out a reference that has to be
+// given back with release; the GL texture is deleted when the last reference goes away.
+// prefetch may be called from any thread, everything else only from the thread owning the GL context.
+class TextureManager {
+public:
+    static TextureManager &instance()
+    {
+        static TextureManager manager;
+        return manager;
+    }
+
+    static std::string canonicalPath(const std::string &path)
+    {
+        char resolved[PATH_MAX];
+        return realpath(path.c_str(), resolved) ? std::string(resolved) : path;
+    }
+
+    // starts decoding the image on the pool unless it is already loaded or being decoded
+    void prefetch(const std::string &path, ThreadPool &pool)
+    {
+        std::string key = canonicalPath(path);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (textures.count(key))
+            return;
+        textures[key].image = pool.submit([key] { return decodeTextureImage(key); }).share();
+    }
+
+    // returns the texture for the image file, uploading it (and decoding it, unless prefetched) on first use
+    unsigned int acquire(const std::string &path)
+    {
+        std::string key = canonicalPath(path);
+        std::shared_future<TextureImage> image;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            Entry &entry = textures[key];
+            if (entry.id)
+            {
+                entry.references++;
+                return entry.id;
+            }
+            image = entry.image;
+        }
+
+        // decode and upload without holding the lock, so workers can keep prefetching meanwhile
+        unsigned int id = image.valid() ? uploadTextureImage(image.get(), path)
+                                        : uploadTextureImage(decodeTextureImage(key), path);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry &entry = textures[key];
+        entry.id = id;
+        entry.references = 1;
+        entry.image = std::shared_future<TextureImage>();
+        paths[id] = key;
+        return id;
+    }
+
+    // gives back a reference obtained from acquire
+    void release(unsigned int id)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto path = paths.find(id);
+        if (path == paths.end())
+            return;
+        auto entry = textures.find(path->second);
+        if (--entry->second.references == 0)
+        {
+            GLState::instance().deleteTexture(id);
+            textures.erase(entry);
+            paths.erase(path);
+        }
+    }
+
+    // deletes every texture regardless of outstanding references, to be called before the GL context goes away.
+    // releasing a reference afterwards does nothing.
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto &path : paths)
+            GLState::instance().deleteTexture(path.first);
+        textures.clear();
+        paths.clear();
+    }
+
+private:
+    struct Entry {
+        unsigned int id = 0;
+        unsigned int references = 0;
+        std::shared_future<TextureImage> image;  // pending decode, dropped once uploaded
+    };
+
+    std::mutex mutex;
+    std::unordered_map<std::string, Entry> textures;
+    std::unordered_map<unsigned int, std::string> paths;
+
+    TextureManager() = default;
+};
+#endif
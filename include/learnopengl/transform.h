@@ -0,0 +1,47 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader_m.h>
+
+// Model matrix of a placed object together with the matrix that transforms its normals.
+//
+// Normals only stay perpendicular to the surface under a non-uniform scale when they are transformed by the
+// inverse transpose of the model matrix. Inverting per vertex in the shader costs a 4x4 inverse for every vertex
+// of every draw, so the normal matrix is computed here once, when the model matrix actually changes, and uploaded
+// next to it.
+class Transform {
+public:
+    // recomputes the normal matrix only if matrix differs from the current model matrix
+    void set(const glm::mat4 &matrix)
+    {
+        if (valid && matrix == modelMatrix)
+            return;
+        modelMatrix = matrix;
+        normalMatrix = glm::mat3(glm::transpose(glm::inverse(matrix)));
+        valid = true;
+    }
+
+    const glm::mat4 &model() const { return modelMatrix; }
+    const glm::mat3 &normal() const { return normalMatrix; }
+
+private:
+    glm::mat4 modelMatrix = glm::mat4(1.0f);
+    glm::mat3 normalMatrix = glm::mat3(1.0f);
+    bool valid = false;
+};
+
+// handles of the model and normalMatrix uniforms of a program
+struct TransformUniforms {
+    UniformHandle model;
+    UniformHandle normalMatrix;
+};
+
+// uploads both matrices of transform, shader must be in use
+inline void setTransform(const Shader &shader, const TransformUniforms &uniforms, const Transform &transform)
+{
+    shader.setMat4(uniforms.model, transform.model());
+    shader.setMat3(uniforms.normalMatrix, transform.normal());
+}
+#endif
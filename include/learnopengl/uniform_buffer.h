@@ -0,0 +1,118 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <learnopengl/uniform_struct.h>
+
+// binding points of the uniform blocks shared by all programs, see Shader::bindUniformBlock
+#define CAMERA_BLOCK_BINDING 0
+#define LIGHTS_BLOCK_BINDING 1
+
+// C++ mirror of the std140 Camera block declared in the shaders. Every vec3 is followed by a float so the struct
+// has no implicit padding and matches the std140 offsets member for member.
+
+// layout (std140) uniform Camera
+struct CameraBlock {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec3 viewPosition;
+    float     padding;
+};
+
+static_assert(sizeof(CameraBlock) == 144, "CameraBlock does not match the std140 layout");
+
+// uniform buffer holding one block, attached to its binding point for the lifetime of the object.
+// update only uploads when the contents differ from the last upload, so unchanged state costs a compare.
+template<typename Block>
+class UniformBuffer {
+public:
+    explicit UniformBuffer(GLuint binding)
+    {
+        glGenBuffers(1, &ID);
+        glBindBuffer(GL_UNIFORM_BUFFER, ID);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, ID);
+    }
+
+    UniformBuffer(const UniformBuffer &) = delete;
+    UniformBuffer &operator=(const UniformBuffer &) = delete;
+
+    // returns whether the block was uploaded
+    bool update(const Block &block)
+    {
+        if (uploaded && memcmp(&block, &current, sizeof(Block)) == 0)
+            return false;
+        current = block;
+        uploaded = true;
+        glBindBuffer(GL_UNIFORM_BUFFER, ID);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &current);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        return true;
+    }
+
+    unsigned int ID = 0;
+
+private:
+    Block current;
+    bool uploaded = false;
+};
+
+// uniform buffer for a block whose layout is taken from the driver (see UniformBlockLayout), filled from C++
+// structs bound to its members. update uploads the whole block in one call when the contents changed.
+class UniformBlockBuffer {
+public:
+    UniformBlockBuffer(const UniformBlockLayout &layout, GLuint binding)
+        : binding(binding)
+    {
+        glGenBuffers(1, &ID);
+        resize(layout);
+    }
+
+    // takes over a new layout of the block, e.g. after a reloaded program changed it. The contents are cleared,
+    // the members have to be set again before the next update.
+    void resize(const UniformBlockLayout &layout)
+    {
+        contents.assign(layout.size, 0);
+        uploaded.clear();
+        glBindBuffer(GL_UNIFORM_BUFFER, ID);
+        glBufferData(GL_UNIFORM_BUFFER, contents.size(), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, ID);
+    }
+
+    UniformBlockBuffer(const UniformBlockBuffer &) = delete;
+    UniformBlockBuffer &operator=(const UniformBlockBuffer &) = delete;
+
+    template<typename T>
+    void set(const UniformStruct<T> &member, const T &value)
+    {
+        member.pack(value, contents.data());
+    }
+
+    // returns whether the block was uploaded
+    bool update()
+    {
+        if (uploaded.size() == contents.size() && memcmp(uploaded.data(), contents.data(), contents.size()) == 0)
+            return false;
+        uploaded = contents;
+        glBindBuffer(GL_UNIFORM_BUFFER, ID);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, contents.size(), contents.data());
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        return true;
+    }
+
+    unsigned int ID = 0;
+
+private:
+    GLuint binding;
+    std::vector<unsigned char> contents;
+    std::vector<unsigned char> uploaded;
+};
+#endif
@@ -0,0 +1,197 @@
+#ifndef UNIFORM_STRUCT_H
+#define UNIFORM_STRUCT_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <string>
+#include <vector>
+#include <iostream>
+
+// Mapping of C++ structs onto GLSL structs inside uniform blocks.
+//
+// A struct is described once with UNIFORM_STRUCT, naming the members that mirror the GLSL struct members of the
+// same name. The description is checked when compiling (every member type must be an uploadable type and the
+// listed members must lay out the struct with each member once, see uniformFieldsCover) and, when bound to a block
+// with UniformBlockLayout::bind, against the block layout the driver reports, so the C++ struct needs neither the
+// GLSL member order nor std140 padding.
+
+// GL type of a C++ member type. Matrices other than mat4 and bools have a different layout in blocks and are
+// left out on purpose.
+template<typename T> struct UniformType;
+template<> struct UniformType<float>     { static constexpr GLenum value = GL_FLOAT; };
+template<> struct UniformType<int>       { static constexpr GLenum value = GL_INT; };
+template<> struct UniformType<glm::vec2> { static constexpr GLenum value = GL_FLOAT_VEC2; };
+template<> struct UniformType<glm::vec3> { static constexpr GLenum value = GL_FLOAT_VEC3; };
+template<> struct UniformType<glm::vec4> { static constexpr GLenum value = GL_FLOAT_VEC4; };
+template<> struct UniformType<glm::mat4> { static constexpr GLenum value = GL_FLOAT_MAT4; };
+
+struct UniformField {
+    const char *name;
+    size_t offset;
+    size_t size;
+    size_t alignment;
+    GLenum type;
+};
+
+constexpr size_t alignUp(size_t offset, size_t alignment)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+// whether fields lay out a struct of the given size and alignment: taken by offset, every field starts where the
+// previous one ended (after the padding the alignment of its type asks for) and the last one ends at the tail
+// padding.
+// A member left out leaves a gap and a member listed twice overlaps itself, both fail.
+constexpr bool uniformFieldsCover(std::initializer_list<UniformField> fields, size_t size, size_t alignment)
+{
+    size_t end = 0;
+    for (size_t placed = 0; placed < fields.size(); placed++)
+    {
+        // the field with the lowest offset from end on
+        size_t next = fields.size();
+        for (size_t i = 0; i < fields.size(); i++)
+        {
+            size_t offset = fields.begin()[i].offset;
+            if (offset >= end && (next == fields.size() || offset < fields.begin()[next].offset))
+                next = i;
+        }
+        if (next == fields.size())
+            return false;
+        const UniformField &field = fields.begin()[next];
+        if (field.offset != alignUp(end, field.alignment))
+            return false;
+        end = field.offset + field.size;
+    }
+    return alignUp(end, alignment) == size;
+}
+
+// member descriptions of a struct, see UNIFORM_STRUCT
+template<typename T> struct UniformFields;
+
+#define UNIFORM_FIELD(Struct, member) \
+    UniformField{#member, offsetof(Struct, member), sizeof(Struct::member), alignof(decltype(Struct::member)), \
+                 UniformType<decltype(Struct::member)>::value}
+
+// describes Struct by its members, e.g. UNIFORM_STRUCT(PointLight, UNIFORM_FIELD(PointLight, position), ...)
+#define UNIFORM_STRUCT(Struct, ...) \
+    static_assert(uniformFieldsCover({__VA_ARGS__}, sizeof(Struct), alignof(Struct)), \
+                  "the UNIFORM_STRUCT of " #Struct " does not list each of its members once"); \
+    template<> struct UniformFields<Struct> { \
+        static const std::vector<UniformField> &get() \
+        { \
+            static const std::vector<UniformField> fields = {__VA_ARGS__}; \
+            return fields; \
+        } \
+    }
+
+// a struct bound to a GLSL struct in a block: where each member goes in the block's buffer
+template<typename T>
+class UniformStruct {
+public:
+    struct Copy {
+        size_t from;
+        size_t to;
+        size_t size;
+    };
+
+    // writes value into the buffer contents of the block
+    void pack(const T &value, unsigned char *block) const
+    {
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&value);
+        for (const Copy &copy : copies)
+            memcpy(block + copy.to, bytes + copy.from, copy.size);
+    }
+
+    std::vector<Copy> copies;
+};
+
+// layout of a uniform block as reported by the driver for a linked program
+class UniformBlockLayout {
+public:
+    UniformBlockLayout(GLuint program, const std::string &block) : block(block)
+    {
+        GLuint index = glGetUniformBlockIndex(program, block.c_str());
+        if (index == GL_INVALID_INDEX)
+        {
+            std::cout << "ERROR::UNIFORM_BLOCK:: the program has no uniform block " << block << std::endl;
+            return;
+        }
+        GLint dataSize = 0, count = 0;
+        glGetActiveUniformBlockiv(program, index, GL_UNIFORM_BLOCK_DATA_SIZE, &dataSize);
+        glGetActiveUniformBlockiv(program, index, GL_UNIFORM_BLOCK_ACTIVE_UNIFORMS, &count);
+        size = (size_t)dataSize;
+
+        std::vector<GLint> indices(count);
+        glGetActiveUniformBlockiv(program, index, GL_UNIFORM_BLOCK_ACTIVE_UNIFORM_INDICES, indices.data());
+        std::vector<GLuint> uniformIndices(indices.begin(), indices.end());
+        std::vector<GLint> offsets(count), types(count);
+        glGetActiveUniformsiv(program, count, uniformIndices.data(), GL_UNIFORM_OFFSET, offsets.data());
+        glGetActiveUniformsiv(program, count, uniformIndices.data(), GL_UNIFORM_TYPE, types.data());
+
+        GLint maxLength = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> name(std::max(maxLength, 1));
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            glGetActiveUniformName(program, uniformIndices[i], (GLsizei)name.size(), &length, name.data());
+            members.push_back({std::string(name.data(), length), (size_t)offsets[i], (GLenum)types[i]});
+        }
+    }
+
+    // maps the members of T onto the GLSL struct instance called name in the block. Members missing on either
+    // side or with different types are reported and left out.
+    template<typename T>
+    UniformStruct<T> bind(const std::string &name) const
+    {
+        UniformStruct<T> result;
+        const std::vector<UniformField> &fields = UniformFields<T>::get();
+        for (const UniformField &field : fields)
+        {
+            const Member *member = find(name + '.' + field.name);
+            if (!member)
+                std::cout << "ERROR::UNIFORM_BLOCK:: " << block << " has no member " << name << '.' << field.name << std::endl;
+            else if (member->type != field.type)
+                std::cout << "ERROR::UNIFORM_BLOCK:: " << block << '.' << member->name << " does not have the type of the C++ member" << std::endl;
+            else
+                result.copies.push_back({field.offset, member->offset, field.size});
+        }
+        std::string prefix = name + '.';
+        for (const Member &member : members)
+        {
+            if (member.name.compare(0, prefix.size(), prefix) != 0)
+                continue;
+            bool mapped = false;
+            for (const UniformField &field : fields)
+                mapped = mapped || member.name.compare(prefix.size(), std::string::npos, field.name) == 0;
+            if (!mapped)
+                std::cout << "ERROR::UNIFORM_BLOCK:: " << block << '.' << member.name << " has no C++ counterpart" << std::endl;
+        }
+        return result;
+    }
+
+    const std::string block;
+    size_t size = 0;
+
+private:
+    struct Member {
+        std::string name;
+        size_t offset;
+        GLenum type;
+    };
+    std::vector<Member> members;
+
+    const Member *find(const std::string &name) const
+    {
+        for (const Member &member : members)
+            if (member.name == name)
+                return &member;
+        return nullptr;
+    }
+};
+#endif
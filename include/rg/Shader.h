@@ -12,9 +12,11 @@
 #include <sstream>
 #include <rg/Error.h>
 #include <common.h>
+#include <uniform_locations.h>
 #include <glm/glm.hpp>
 class Shader {
     unsigned int m_Id;
+    UniformLocations uniforms;
 public:
     Shader(std::string vertexShaderPath, std::string fragmentShaderPath) {
         appendShaderFolderIfNotPresent(vertexShaderPath);
@@ -65,6 +67,7 @@ public:
         glDeleteShader(vertexShader);
         glDeleteShader(fragmentShader);
         m_Id = shaderProgram;
+        uniforms.reflect(m_Id);
     }
 
     // activate the shader
@@ -77,59 +80,117 @@ public:
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(m_Id, name.c_str()), (int)value);
+        uniforms.set(uniforms.location(name), (GLint)value, glUniform1i);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     {
-        glUniform1i(glGetUniformLocation(m_Id, name.c_str()), value);
+        uniforms.set(uniforms.location(name), value, glUniform1i);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     {
-        glUniform1f(glGetUniformLocation(m_Id, name.c_str()), value);
+        uniforms.set(uniforms.location(name), value, glUniform1f);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     {
-        glUniform2fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+        uniforms.set(uniforms.location(name), value, glUniform2fv);
     }
     void setVec2(const std::string &name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(m_Id, name.c_str()), x, y);
+        setVec2(name, glm::vec2(x, y));
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     {
-        glUniform3fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+        uniforms.set(uniforms.location(name), value, glUniform3fv);
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(m_Id, name.c_str()), x, y, z);
+        setVec3(name, glm::vec3(x, y, z));
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     {
-        glUniform4fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+        uniforms.set(uniforms.location(name), value, glUniform4fv);
     }
     void setVec4(const std::string &name, float x, float y, float z, float w)
     {
-        glUniform4f(glGetUniformLocation(m_Id, name.c_str()), x, y, z, w);
+        setVec4(name, glm::vec4(x, y, z, w));
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        uniforms.set(uniforms.location(name), mat, glUniformMatrix2fv);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        uniforms.set(uniforms.location(name), mat, glUniformMatrix3fv);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        uniforms.set(uniforms.location(name), mat, glUniformMatrix4fv);
+    }
+    // uniform uploads issued and skipped as redundant for this program, uniformUploadStats() sums all programs
+    // ------------------------------------------------------------------------
+    const UniformUploadStats &uploadStats() const
+    {
+        return uniforms.uploadStats();
+    }
+
+    // handle based uniform functions, setting a uniform through its handle skips the name lookup
+    // ------------------------------------------------------------------------
+    UniformHandle uniform(const std::string &name)
+    {
+        return uniforms.handle(name);
+    }
+    // ------------------------------------------------------------------------
+    void setBool(UniformHandle uniform, bool value) const
+    {
+        uniforms.set(uniforms.location(uniform), (GLint)value, glUniform1i);
+    }
+    // ------------------------------------------------------------------------
+    void setInt(UniformHandle uniform, int value) const
+    {
+        uniforms.set(uniforms.location(uniform), value, glUniform1i);
+    }
+    // ------------------------------------------------------------------------
+    void setFloat(UniformHandle uniform, float value) const
+    {
+        uniforms.set(uniforms.location(uniform), value, glUniform1f);
+    }
+    // ------------------------------------------------------------------------
+    void setVec2(UniformHandle uniform, const glm::vec2 &value) const
+    {
+        uniforms.set(uniforms.location(uniform), value, glUniform2fv);
+    }
+    // ------------------------------------------------------------------------
+    void setVec3(UniformHandle uniform, const glm::vec3 &value) const
+    {
+        uniforms.set(uniforms.location(uniform), value, glUniform3fv);
+    }
+    // ------------------------------------------------------------------------
+    void setVec4(UniformHandle uniform, const glm::vec4 &value) const
+    {
+        uniforms.set(uniforms.location(uniform), value, glUniform4fv);
+    }
+    // ------------------------------------------------------------------------
+    void setMat2(UniformHandle uniform, const glm::mat2 &mat) const
+    {
+        uniforms.set(uniforms.location(uniform), mat, glUniformMatrix2fv);
+    }
+    // ------------------------------------------------------------------------
+    void setMat3(UniformHandle uniform, const glm::mat3 &mat) const
+    {
+        uniforms.set(uniforms.location(uniform), mat, glUniformMatrix3fv);
+    }
+    // ------------------------------------------------------------------------
+    void setMat4(UniformHandle uniform, const glm::mat4 &mat) const
+    {
+        uniforms.set(uniforms.location(uniform), mat, glUniformMatrix4fv);
     }
     void deleteProgram() {
         glDeleteProgram(m_Id);
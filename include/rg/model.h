@@ -8,6 +8,7 @@
 #include <vector>
 #include <string>
 #include <learnopengl/shader.h>
+#include <learnopengl/texture.h>
 #include <rg/mesh.h>
 
 #include <assimp/Importer.hpp>
@@ -135,7 +136,7 @@ private:
 
             if (!skip) {
                 Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
+                texture.id = TextureManager::instance().acquire(this->directory + "/" + str.C_Str());
                 texture.type = typeName;
                 texture.path = str.C_Str();
                 textures.push_back(texture);
@@ -0,0 +1,296 @@
+//
+// Uniform location cache shared by the Shader classes.
+//
+
+#ifndef PROJECT_BASE_UNIFORM_LOCATIONS_H
+#define PROJECT_BASE_UNIFORM_LOCATIONS_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// handle of a uniform returned by Shader::uniform, an index into the shader's location table so setting
+// the uniform through it does not hash the name
+struct UniformHandle {
+    unsigned int index;
+};
+
+// glUniform* calls issued and skipped because the program already held the value
+struct UniformUploadStats {
+    unsigned long long issued = 0;
+    unsigned long long elided = 0;
+};
+
+// totals over all programs
+inline UniformUploadStats &uniformUploadStats()
+{
+    static UniformUploadStats stats;
+    return stats;
+}
+
+// locations of the uniforms of a linked program. The active uniforms are read once after linking, names that
+// are not active are looked up on first use and remembered as well (as -1, which glUniform* ignores).
+class UniformLocations {
+public:
+    // reads the locations of all active uniforms, replacing those of a previously linked program
+    void reflect(GLuint program)
+    {
+        this->program = program;
+        locations.clear();
+        shadows.clear();
+
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> buffer(std::max(maxLength, 1));
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(program, (GLuint)i, (GLsizei)buffer.size(), &length, &size, &type, buffer.data());
+            std::string name(buffer.data(), length);
+            GLint location = glGetUniformLocation(program, name.c_str());
+            // members of uniform blocks have no location
+            if (location < 0)
+                continue;
+            locations[name] = location;
+            if (location < MAX_SHADOWED_LOCATION && (size_t)(location + size) > shadows.size())
+                shadows.resize(std::min(location + size, MAX_SHADOWED_LOCATION));
+
+            // arrays are reported by their first element, the other elements and the bare name are valid as well
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+            {
+                std::string base = name.substr(0, name.size() - 3);
+                locations[base] = location;
+                for (GLint element = 1; element < size; element++)
+                {
+                    std::string elementName = base + '[' + std::to_string(element) + ']';
+                    locations[elementName] = glGetUniformLocation(program, elementName.c_str());
+                }
+            }
+        }
+
+        for (size_t i = 0; i < handleNames.size(); i++)
+            handleLocations[i] = location(handleNames[i]);
+    }
+
+    GLint location(const std::string &name) const
+    {
+        auto found = locations.find(name);
+        if (found != locations.end())
+            return found->second;
+        GLint location = glGetUniformLocation(program, name.c_str());
+        locations.emplace(name, location);
+        return location;
+    }
+
+    GLint location(UniformHandle handle) const
+    {
+        return handleLocations[handle.index];
+    }
+
+    // records value as the contents of location and returns whether the program held something else, i.e.
+    // whether the glUniform* call is needed. Values are compared bit for bit, writes to -1 are never needed.
+    bool changed(GLint location, const void *value, size_t size) const
+    {
+        if (location < 0)
+            return false;
+        UniformUploadStats &totals = uniformUploadStats();
+        if (location >= MAX_SHADOWED_LOCATION || size > sizeof(Shadow::data))
+        {
+            stats.issued++;
+            totals.issued++;
+            return true;
+        }
+        if ((size_t)location >= shadows.size())
+            shadows.resize(location + 1);
+        Shadow &shadow = shadows[location];
+        if (shadow.size == size && memcmp(shadow.data, value, size) == 0)
+        {
+            stats.elided++;
+            totals.elided++;
+            return false;
+        }
+        memcpy(shadow.data, value, size);
+        shadow.size = (uint32_t)size;
+        stats.issued++;
+        totals.issued++;
+        return true;
+    }
+
+    // uploads value to location with the glUniform* call upload, unless the program already holds it (see
+    // changed). There is one overload per shape of glUniform* call: scalars, vectors and matrices.
+    void set(GLint location, GLint value, PFNGLUNIFORM1IPROC upload) const
+    {
+        if (changed(location, &value, sizeof(value)))
+            upload(location, value);
+    }
+    void set(GLint location, GLfloat value, PFNGLUNIFORM1FPROC upload) const
+    {
+        if (changed(location, &value, sizeof(value)))
+            upload(location, value);
+    }
+    template <typename Vector>
+    void set(GLint location, const Vector &value, PFNGLUNIFORM2FVPROC upload) const
+    {
+        if (changed(location, &value[0], sizeof(value)))
+            upload(location, 1, &value[0]);
+    }
+    template <typename Matrix>
+    void set(GLint location, const Matrix &value, PFNGLUNIFORMMATRIX2FVPROC upload) const
+    {
+        if (changed(location, &value[0][0], sizeof(value)))
+            upload(location, 1, GL_FALSE, &value[0][0]);
+    }
+
+    const UniformUploadStats &uploadStats() const { return stats; }
+
+    // handles stay valid when the program is linked again and reflected
+    UniformHandle handle(const std::string &name)
+    {
+        auto found = std::find(handleNames.begin(), handleNames.end(), name);
+        if (found != handleNames.end())
+            return {(unsigned int)(found - handleNames.begin())};
+        handleNames.push_back(name);
+        handleLocations.push_back(location(name));
+        return {(unsigned int)(handleNames.size() - 1)};
+    }
+
+private:
+    // last value written to a location, size 0 until the first write. Locations past MAX_SHADOWED_LOCATION
+    // (drivers hand out small consecutive numbers in practice) are always uploaded.
+    struct Shadow {
+        uint32_t size = 0;
+        unsigned char data[64];
+    };
+    static const GLint MAX_SHADOWED_LOCATION = 4096;
+
+    GLuint program = 0;
+    mutable std::unordered_map<std::string, GLint> locations;
+    mutable std::vector<Shadow> shadows;
+    mutable UniformUploadStats stats;
+    std::vector<std::string> handleNames;
+    std::vector<GLint> handleLocations;
+};
+
+// whether type is one of the sampler types of GL 3.3
+inline bool isSamplerType(GLenum type)
+{
+    switch (type)
+    {
+        case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE:
+        case GL_SAMPLER_1D_SHADOW: case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_CUBE_SHADOW:
+        case GL_SAMPLER_1D_ARRAY: case GL_SAMPLER_2D_ARRAY: case GL_SAMPLER_1D_ARRAY_SHADOW:
+        case GL_SAMPLER_2D_ARRAY_SHADOW: case GL_SAMPLER_2D_MULTISAMPLE: case GL_SAMPLER_2D_MULTISAMPLE_ARRAY:
+        case GL_SAMPLER_BUFFER: case GL_SAMPLER_2D_RECT: case GL_SAMPLER_2D_RECT_SHADOW:
+        case GL_INT_SAMPLER_1D: case GL_INT_SAMPLER_2D: case GL_INT_SAMPLER_3D: case GL_INT_SAMPLER_CUBE:
+        case GL_INT_SAMPLER_1D_ARRAY: case GL_INT_SAMPLER_2D_ARRAY: case GL_INT_SAMPLER_2D_MULTISAMPLE:
+        case GL_INT_SAMPLER_2D_MULTISAMPLE_ARRAY: case GL_INT_SAMPLER_BUFFER: case GL_INT_SAMPLER_2D_RECT:
+        case GL_UNSIGNED_INT_SAMPLER_1D: case GL_UNSIGNED_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_3D:
+        case GL_UNSIGNED_INT_SAMPLER_CUBE: case GL_UNSIGNED_INT_SAMPLER_1D_ARRAY:
+        case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY: case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE:
+        case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE_ARRAY: case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+        case GL_UNSIGNED_INT_SAMPLER_2D_RECT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// copies the values of the default block uniforms and the uniform block bindings that two programs have in
+// common from one to the other, used to carry state over to a rebuilt program. Changes the current program
+// for the duration of the call.
+inline void copyUniformState(GLuint from, GLuint to)
+{
+    GLint previous = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+    glUseProgram(to);
+
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(to, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(to, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<GLchar> buffer(std::max(maxLength, 1));
+    for (GLint i = 0; i < count; i++)
+    {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(to, (GLuint)i, (GLsizei)buffer.size(), &length, &size, &type, buffer.data());
+        std::string name(buffer.data(), length);
+        bool array = name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0;
+        for (GLint element = 0; element < size; element++)
+        {
+            std::string elementName = array ? name.substr(0, name.size() - 3) + '[' + std::to_string(element) + ']' : name;
+            GLint source = glGetUniformLocation(from, elementName.c_str());
+            GLint target = glGetUniformLocation(to, elementName.c_str());
+            // block members have no location, new uniforms keep their defaults
+            if (source < 0 || target < 0)
+                continue;
+
+            GLfloat floats[16];
+            GLint ints[4];
+            GLuint uints[4];
+            switch (type)
+            {
+                case GL_FLOAT:        glGetUniformfv(from, source, floats); glUniform1fv(target, 1, floats); break;
+                case GL_FLOAT_VEC2:   glGetUniformfv(from, source, floats); glUniform2fv(target, 1, floats); break;
+                case GL_FLOAT_VEC3:   glGetUniformfv(from, source, floats); glUniform3fv(target, 1, floats); break;
+                case GL_FLOAT_VEC4:   glGetUniformfv(from, source, floats); glUniform4fv(target, 1, floats); break;
+                case GL_FLOAT_MAT2:   glGetUniformfv(from, source, floats); glUniformMatrix2fv(target, 1, GL_FALSE, floats); break;
+                case GL_FLOAT_MAT3:   glGetUniformfv(from, source, floats); glUniformMatrix3fv(target, 1, GL_FALSE, floats); break;
+                case GL_FLOAT_MAT4:   glGetUniformfv(from, source, floats); glUniformMatrix4fv(target, 1, GL_FALSE, floats); break;
+                case GL_FLOAT_MAT2x3: glGetUniformfv(from, source, floats); glUniformMatrix2x3fv(target, 1, GL_FALSE, floats); break;
+                case GL_FLOAT_MAT2x4: glGetUniformfv(from, source, floats); glUniformMatrix2x4fv(target, 1, GL_FALSE, floats); break;
+                case GL_FLOAT_MAT3x2: glGetUniformfv(from, source, floats); glUniformMatrix3x2fv(target, 1, GL_FALSE, floats); break;
+                case GL_FLOAT_MAT3x4: glGetUniformfv(from, source, floats); glUniformMatrix3x4fv(target, 1, GL_FALSE, floats); break;
+                case GL_FLOAT_MAT4x2: glGetUniformfv(from, source, floats); glUniformMatrix4x2fv(target, 1, GL_FALSE, floats); break;
+                case GL_FLOAT_MAT4x3: glGetUniformfv(from, source, floats); glUniformMatrix4x3fv(target, 1, GL_FALSE, floats); break;
+                case GL_INT:
+                case GL_BOOL:         glGetUniformiv(from, source, ints); glUniform1iv(target, 1, ints); break;
+                case GL_INT_VEC2:
+                case GL_BOOL_VEC2:    glGetUniformiv(from, source, ints); glUniform2iv(target, 1, ints); break;
+                case GL_INT_VEC3:
+                case GL_BOOL_VEC3:    glGetUniformiv(from, source, ints); glUniform3iv(target, 1, ints); break;
+                case GL_INT_VEC4:
+                case GL_BOOL_VEC4:    glGetUniformiv(from, source, ints); glUniform4iv(target, 1, ints); break;
+                case GL_UNSIGNED_INT:      glGetUniformuiv(from, source, uints); glUniform1uiv(target, 1, uints); break;
+                case GL_UNSIGNED_INT_VEC2: glGetUniformuiv(from, source, uints); glUniform2uiv(target, 1, uints); break;
+                case GL_UNSIGNED_INT_VEC3: glGetUniformuiv(from, source, uints); glUniform3uiv(target, 1, uints); break;
+                case GL_UNSIGNED_INT_VEC4: glGetUniformuiv(from, source, uints); glUniform4uiv(target, 1, uints); break;
+                // samplers hold their texture unit, the remaining types (doubles, images, ...) are not copied
+                default:
+                    if (isSamplerType(type))
+                    {
+                        glGetUniformiv(from, source, ints);
+                        glUniform1iv(target, 1, ints);
+                    }
+                    break;
+            }
+        }
+    }
+
+    GLint blocks = 0;
+    glGetProgramiv(to, GL_ACTIVE_UNIFORM_BLOCKS, &blocks);
+    for (GLint i = 0; i < blocks; i++)
+    {
+        GLsizei length = 0;
+        GLchar blockName[256];
+        glGetActiveUniformBlockName(to, (GLuint)i, sizeof(blockName), &length, blockName);
+        GLuint source = glGetUniformBlockIndex(from, blockName);
+        if (source == GL_INVALID_INDEX)
+            continue;
+        GLint binding = 0;
+        glGetActiveUniformBlockiv(from, source, GL_UNIFORM_BLOCK_BINDING, &binding);
+        glUniformBlockBinding(to, (GLuint)i, (GLuint)binding);
+    }
+
+    glUseProgram((GLuint)previous);
+}
+
+#endif //PROJECT_BASE_UNIFORM_LOCATIONS_H
@@ -0,0 +1,6 @@
+// camera state shared by all programs, see CameraBlock
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
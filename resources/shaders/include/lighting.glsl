@@ -0,0 +1,65 @@
+// Phong lighting shared by the lit shaders. The material textures are sampled once per fragment into a Surface,
+// every light then only adds its own direction, attenuation and colours.
+#include "lights.glsl"
+
+struct Surface {
+    vec3 diffuse;
+    vec3 specular;
+    float shininess;
+};
+
+Surface SampleSurface(sampler2D diffuseMap, sampler2D specularMap, vec2 texCoords, float shininess)
+{
+    Surface surface;
+    surface.diffuse = texture(diffuseMap, texCoords).rgb;
+    surface.specular = texture(specularMap, texCoords).xxx;
+    surface.shininess = shininess;
+    return surface;
+}
+
+// ambient, diffuse and specular terms of a light arriving from lightDir, all scaled by intensity
+vec3 Shade(vec3 ambient, vec3 diffuse, vec3 specular, vec3 lightDir, float intensity, Surface surface, vec3 normal, vec3 viewDir)
+{
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), surface.shininess);
+    // combine results
+    return intensity * ((ambient + diffuse * diff) * surface.diffuse + specular * spec * surface.specular);
+}
+
+float Attenuation(float constant, float linear, float quadratic, float distance)
+{
+    return 1.0 / (constant + linear * distance + quadratic * (distance * distance));
+}
+
+// direction to a light at position and its distance, both from one inverse square root
+vec3 LightDirection(vec3 position, vec3 fragPos, out float distance)
+{
+    vec3 toLight = position - fragPos;
+    float distanceSquared = dot(toLight, toLight);
+    float inverseDistance = inversesqrt(distanceSquared);
+    distance = distanceSquared * inverseDistance;
+    return toLight * inverseDistance;
+}
+
+vec3 CalcPointLight(PointLight light, Surface surface, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    float distance;
+    vec3 lightDir = LightDirection(light.position, fragPos, distance);
+    float attenuation = Attenuation(light.constant, light.linear, light.quadratic, distance);
+    return Shade(light.ambient, light.diffuse, light.specular, lightDir, attenuation, surface, normal, viewDir);
+}
+
+vec3 CalcSpotLight(SpotLight light, Surface surface, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    float distance;
+    vec3 lightDir = LightDirection(light.position, fragPos, distance);
+    float attenuation = Attenuation(light.constant, light.linear, light.quadratic, distance);
+    // spotlight intensity
+    float theta = dot(lightDir, normalize(-light.direction));
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    return Shade(light.ambient, light.diffuse, light.specular, lightDir, attenuation * intensity, surface, normal, viewDir);
+}
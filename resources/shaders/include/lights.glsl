@@ -0,0 +1,29 @@
+// filled from the C++ structs of the same name through their UNIFORM_STRUCT descriptions
+struct PointLight {
+    vec3 position;
+    float constant;
+    vec3 ambient;
+    float linear;
+    vec3 diffuse;
+    float quadratic;
+    vec3 specular;
+};
+
+struct SpotLight {
+    vec3 position;
+    float cutOff;
+    vec3 direction;
+    float outerCutOff;
+    vec3 ambient;
+    float constant;
+    vec3 diffuse;
+    float linear;
+    vec3 specular;
+    float quadratic;
+};
+
+// Which light is used is decided when the program is built (SPOT_LIGHT), not per fragment.
+layout (std140) uniform Lights {
+    PointLight pointLight;
+    SpotLight spotLight;
+};
@@ -0,0 +1,16 @@
+// placement of the drawn object, see Transform. Instanced programs (INSTANCED) read the matrices from per instance
+// vertex attributes filled in by the RenderQueue, the others from uniforms.
+#ifdef INSTANCED
+layout (location = 5) in mat4 instanceModel;
+layout (location = 9) in mat3 instanceNormalMatrix;
+
+mat4 ModelMatrix() { return instanceModel; }
+mat3 NormalMatrix() { return instanceNormalMatrix; }
+#else
+uniform mat4 model;
+// inverse transpose of the model matrix, computed on the CPU
+uniform mat3 normalMatrix;
+
+mat4 ModelMatrix() { return model; }
+mat3 NormalMatrix() { return normalMatrix; }
+#endif
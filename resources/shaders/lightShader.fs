@@ -1,12 +1,12 @@
 #version 330 core
 out vec4 FragColor;
 
-uniform bool spotLightEnabled;
-
 void main()
 {
-    if(spotLightEnabled == false)
-        FragColor = vec4(1.0);
-    else
-        FragColor = vec4(0.1);
+    // the lamp is dimmed while the flashlight is on
+#ifdef SPOT_LIGHT
+    FragColor = vec4(0.1);
+#else
+    FragColor = vec4(1.0);
+#endif
 }
\ No newline at end of file
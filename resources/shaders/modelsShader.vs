@@ -7,14 +7,17 @@ out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "include/camera.glsl"
+#include "include/transform.glsl"
+// dequantization of packed vertex positions (identity for full float vertices)
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = aNormal;
+    vec3 position = aPos * positionScale + positionOffset;
+    FragPos = vec3(ModelMatrix() * vec4(position, 1.0));
+    Normal = NormalMatrix() * aNormal;
     TexCoords = aTexCoords;
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
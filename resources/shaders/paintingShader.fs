@@ -7,98 +7,24 @@ struct Material {
     float shininess;
 };
 
-struct PointLight {
-    vec3 position;
-
-    vec3 specular;
-    vec3 diffuse;
-    vec3 ambient;
-
-    float constant;
-    float linear;
-    float quadratic;
-};
-
-struct SpotLight {
-    vec3 position;
-    vec3 direction;
-    float cutOff;
-    float outerCutOff;
-
-    float constant;
-    float linear;
-    float quadratic;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
 
-uniform vec3 viewPos;
 uniform Material material;
-uniform PointLight pointLight;
-uniform SpotLight spotLight;
-uniform bool spotLightEnabled;
 
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
-{
-    vec3 lightDir = normalize(light.position - fragPos);
-    // diffuse shading
-    float diff = max(dot(normal, lightDir), 0.0);
-    // specular shading
-    vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    // attenuation
-    float distance = length(light.position - fragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
-    // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords).rgb);
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords).rgb);
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords).xxx);
-    ambient *= attenuation;
-    diffuse *= attenuation;
-    specular *= attenuation;
-    return (ambient + diffuse + specular);
-}
-
-vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
-{
-    vec3 lightDir = normalize(light.position - fragPos);
-    // diffuse shading
-    float diff = max(dot(normal, lightDir), 0.0);
-    // specular shading
-    vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    // attenuation
-    float distance = length(light.position - fragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
-    // spotlight intensity
-    float theta = dot(lightDir, normalize(-light.direction));
-    float epsilon = light.cutOff - light.outerCutOff;
-    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
-    // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords).rgb);
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords).rgb);
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords).xxx);
-    ambient *= attenuation * intensity;
-    diffuse *= attenuation * intensity;
-    specular *= attenuation * intensity;
-    return (ambient + diffuse + specular);
-}
+#include "include/camera.glsl"
+#include "include/lighting.glsl"
 
 void main()
 {
     vec3 normal = normalize(Normal);
-      vec3 viewDir = normalize(viewPos - FragPos);
-      vec3 result = CalcPointLight(pointLight, normal, FragPos, viewDir);;
-      if(spotLightEnabled){
-              result = CalcSpotLight(spotLight, normal, FragPos, viewDir);
-      } else{
-              result = CalcPointLight(pointLight, normal, FragPos, viewDir);
-      }
-      FragColor = vec4(result, 1.0);
+    vec3 viewDir = normalize(viewPosition - FragPos);
+    Surface surface = SampleSurface(material.diffuse, material.specular, TexCoords, material.shininess);
+#ifdef SPOT_LIGHT
+    vec3 result = CalcSpotLight(spotLight, surface, normal, FragPos, viewDir);
+#else
+    vec3 result = CalcPointLight(pointLight, surface, normal, FragPos, viewDir);
+#endif
+    FragColor = vec4(result, 1.0);
 }
\ No newline at end of file
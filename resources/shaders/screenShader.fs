@@ -8,14 +8,13 @@ uniform int SCR_WIDTH;
 uniform int SCR_HEIGHT;
 float offset = 1.0 / 300.0;
 
-uniform bool blurEnabled;
-
 void main()
 {
     ivec2 viewportDim = ivec2(SCR_WIDTH, SCR_HEIGHT);
     ivec2 coords = ivec2(viewportDim * TexCoords);
 
-    if(blurEnabled){
+#ifdef BLUR
+    {
         vec2 offsets[9] = vec2[](
             vec2(-offset, offset),
             vec2(0.0f, offset),
@@ -45,8 +44,11 @@ void main()
          }
 
         FragColor = vec4(col, 1.0);
-    }else{
+    }
+#else
+    {
         vec3 col = texture(screenTexture, TexCoords).rgb;
         FragColor = vec4(col, 1.0);
     }
+#endif
 }
@@ -11,12 +11,19 @@
 
 #include <learnopengl/filesystem.h>
 #include <learnopengl/shader_m.h>
+#include <learnopengl/shader_variants.h>
+#include <learnopengl/shader_watcher.h>
+#include <learnopengl/uniform_buffer.h>
+#include <learnopengl/gpu_timer.h>
+#include <learnopengl/transform.h>
+#include <learnopengl/render_queue.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/geometry_arena.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
 
 #include <iostream>
 
-unsigned int loadTexture(char const * path);
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 void mouse_callback(GLFWwindow *window, double xpos, double ypos);
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
@@ -24,6 +31,9 @@ void processInput(GLFWwindow *window);
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+// height of the window's framebuffer in pixels, larger than SCR_HEIGHT on HiDPI displays, kept up to date by
+// framebuffer_size_callback
+int framebufferHeight = SCR_HEIGHT;
 
 // camera
 
@@ -62,6 +72,19 @@ struct SpotLight {
     glm::vec3 specular;
 };
 
+// the lights are uploaded to the GLSL structs of the same name in the Lights block
+UNIFORM_STRUCT(PointLight,
+               UNIFORM_FIELD(PointLight, position), UNIFORM_FIELD(PointLight, ambient),
+               UNIFORM_FIELD(PointLight, diffuse), UNIFORM_FIELD(PointLight, specular),
+               UNIFORM_FIELD(PointLight, constant), UNIFORM_FIELD(PointLight, linear),
+               UNIFORM_FIELD(PointLight, quadratic));
+UNIFORM_STRUCT(SpotLight,
+               UNIFORM_FIELD(SpotLight, position), UNIFORM_FIELD(SpotLight, direction),
+               UNIFORM_FIELD(SpotLight, cutOff), UNIFORM_FIELD(SpotLight, outerCutOff),
+               UNIFORM_FIELD(SpotLight, constant), UNIFORM_FIELD(SpotLight, linear),
+               UNIFORM_FIELD(SpotLight, quadratic), UNIFORM_FIELD(SpotLight, ambient),
+               UNIFORM_FIELD(SpotLight, diffuse), UNIFORM_FIELD(SpotLight, specular));
+
 struct ProgramState {
     glm::vec3 clearColor = glm::vec3(0);
     Camera camera;
@@ -76,6 +99,8 @@ struct ProgramState {
 
     bool spotLightEnabled = false;
     bool blurEnabled = false;
+    // draws the instanced geometry with multi draw indirect (see RenderQueue::setMultiDraw)
+    bool multiDrawEnabled = false;
 
     ProgramState()
             : camera(glm::vec3(0.0f, 0.0f, 0)) {}
@@ -137,6 +162,8 @@ int main() {
     }
     glfwMakeContextCurrent(window);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    int framebufferWidth;
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
     // tell GLFW to capture our mouse
@@ -147,6 +174,7 @@ int main() {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    Shader::enableParallelCompile();
 
     // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
     stbi_set_flip_vertically_on_load(true);
@@ -155,15 +183,32 @@ int main() {
     programState->LoadFromFile("resources/program_state.txt");
 
     // configure global opengl state
-    glEnable(GL_DEPTH_TEST);
+    GLState::instance().enable(GL_DEPTH_TEST);
+
+    // start importing the models
+    // the CPU half of every import (mesh cache or ASSIMP) runs concurrently on the loader pool while the shaders
+    // and buffers below are set up, only the GL upload in the Model constructors happens on this thread.
+    ThreadPool loaderPool;
+    std::future<ModelData> roomData = Model::importAsync(loaderPool, "resources/objects/soba_zavrsena/soba_zavrsena.obj", false);
+    std::future<ModelData> tableData = Model::importAsync(loaderPool, "resources/objects/sto_iz_blendera/table.obj");
+    std::future<ModelData> chairData = Model::importAsync(loaderPool, "resources/objects/stolica/Lucien_Lilippe_Chaise_Louis_XVI/Chaise_louisXVI_deco2.obj");
+    std::future<ModelData> teapotData = Model::importAsync(loaderPool, "resources/objects/teapot/teapot_n_glass.obj");
+    std::future<ModelData> cupData = Model::importAsync(loaderPool, "resources/objects/soljica/cup.obj");
 
     // build and compile shaders
-    Shader roomShader("resources/shaders/roomShader.vs", "resources/shaders/roomShader.fs");
-    Shader modelsShader("resources/shaders/modelsShader.vs", "resources/shaders/modelsShader.fs");
-    Shader lightShader("resources/shaders/lightShader.vs", "resources/shaders/lightShader.fs");
-    Shader paintingShader("resources/shaders/paintingShader.vs", "resources/shaders/paintingShader.fs");
+    // the flashlight and blur toggles are compiled into separate variants of the programs instead of being
+    // branched on in every fragment
+    ShaderVariants roomShaders("resources/shaders/roomShader.vs", "resources/shaders/roomShader.fs", {"SPOT_LIGHT", "INSTANCED"});
+    // the room and the furniture also come in an instanced variant, for models placed more than once and for the
+    // multi draws (see RenderQueue)
+    ShaderVariants modelsShaders("resources/shaders/modelsShader.vs", "resources/shaders/modelsShader.fs", {"SPOT_LIGHT", "INSTANCED"});
+    ShaderVariants lightShaders("resources/shaders/lightShader.vs", "resources/shaders/lightShader.fs", {"SPOT_LIGHT"});
+    ShaderVariants paintingShaders("resources/shaders/paintingShader.vs", "resources/shaders/paintingShader.fs", {"SPOT_LIGHT"});
+
+    ShaderVariants screenShaders("resources/shaders/screenShader.vs", "resources/shaders/screenShader.fs", {"BLUR"});
 
-    Shader screenShader("resources/shaders/screenShader.vs", "resources/shaders/screenShader.fs");
+    // edited shaders are rebuilt while the app runs
+    ShaderWatcher shaderWatcher("resources/shaders");
 
     float t = (1 + sqrt(5))/2;
     float u = (5 - sqrt(5))/10;
@@ -182,7 +227,7 @@ int main() {
             0, -u*t, -u,
     };
 
-    unsigned int indicesLamp[] = {
+    unsigned short indicesLamp[] = {
             0, 8, 4, //first triangle
             0, 5, 10, //second triangle
             2, 4, 9, //third triangle
@@ -267,7 +312,7 @@ int main() {
     glGenVertexArrays(1, &VAO1);
     glGenBuffers(1, &VBO1);
     glGenBuffers(1, &EBO);
-    glBindVertexArray(VAO1);
+    GLState::instance().bindVertexArray(VAO1);
 
     glBindBuffer(GL_ARRAY_BUFFER, VBO1);
     glBufferData(GL_ARRAY_BUFFER, sizeof(verticesLamp), verticesLamp, GL_STATIC_DRAW);
@@ -276,13 +321,13 @@ int main() {
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3*sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    GLState::instance().bindVertexArray(0);
 
     // painting
     unsigned int VBO2, VAO2;
     glGenVertexArrays(1, &VAO2);
     glGenBuffers(1, &VBO2);
-    glBindVertexArray(VAO2);
+    GLState::instance().bindVertexArray(VAO2);
 
     glBindBuffer(GL_ARRAY_BUFFER, VBO2);
     glBufferData(GL_ARRAY_BUFFER, sizeof(verticesPainting), verticesPainting, GL_STATIC_DRAW);
@@ -297,7 +342,7 @@ int main() {
     unsigned int quadVAO, quadVBO;
     glGenVertexArrays(1, &quadVAO);
     glGenBuffers(1, &quadVBO);
-    glBindVertexArray(quadVAO);
+    GLState::instance().bindVertexArray(quadVAO);
     glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
@@ -308,13 +353,13 @@ int main() {
     //MSAA framebuffer
     unsigned int framebuffer;
     glGenFramebuffers(1, &framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    GLState::instance().bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
     // create a multisampled color attachment texture
     unsigned int textureColorBufferMultiSampled;
     glGenTextures(1, &textureColorBufferMultiSampled);
-    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, textureColorBufferMultiSampled);
+    GLState::instance().bindTextureForEdit(0, GL_TEXTURE_2D_MULTISAMPLE, textureColorBufferMultiSampled);
     glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, 4, GL_RGB, SCR_WIDTH, SCR_HEIGHT, GL_TRUE);
-    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+    GLState::instance().bindTexture(0, GL_TEXTURE_2D_MULTISAMPLE, 0);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D_MULTISAMPLE, textureColorBufferMultiSampled, 0);
     // create a (also multisampled) renderbuffer object for depth and stencil attachments
     unsigned int rbo;
@@ -326,15 +371,15 @@ int main() {
 
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GLState::instance().bindFramebuffer(GL_FRAMEBUFFER, 0);
 
     unsigned int intermediateFBO;
     glGenFramebuffers(1, &intermediateFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, intermediateFBO);
+    GLState::instance().bindFramebuffer(GL_FRAMEBUFFER, intermediateFBO);
     // create a color attachment texture
     unsigned int screenTexture;
     glGenTextures(1, &screenTexture);
-    glBindTexture(GL_TEXTURE_2D, screenTexture);
+    GLState::instance().bindTextureForEdit(0, GL_TEXTURE_2D, screenTexture);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -342,38 +387,85 @@ int main() {
 
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         cout << "ERROR::FRAMEBUFFER:: Intermediate framebuffer is not complete!" << endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    // shader configuration
-    screenShader.use();
-    screenShader.setInt("screenTexture", 0);
-
+    GLState::instance().bindFramebuffer(GL_FRAMEBUFFER, 0);
 
     //diffuse and specular textures
-    unsigned int diffuseMap = loadTexture("resources/textures/difuzna.jpg");
-    unsigned int specularMap = loadTexture("resources/textures/spekularna1.jpg");
-
-    paintingShader.use();
-    paintingShader.setInt("material.diffuse", 0);
-    paintingShader.setInt("material.specular", 1);
+    unsigned int diffuseMap = TextureManager::instance().acquire("resources/textures/difuzna.jpg");
+    unsigned int specularMap = TextureManager::instance().acquire("resources/textures/spekularna1.jpg");
 
 
     // load models
-    Model room("resources/objects/soba_zavrsena/soba_zavrsena.obj");
+    // all static geometry of a vertex format goes into one arena, so the render queue can draw it with one vertex
+    // array and, with multi draw on, one call per program and material
+    GeometryArena fullArena(VertexFormat::Full);
+    GeometryArena packedArena(VertexFormat::Packed);
+
+    // nothing reads the geometry back on the CPU, so none of the models keeps a copy after the upload
+    ModelOptions roomOptions;
+    roomOptions.residency = GeometryResidency::Drop;
+    roomOptions.arena = &fullArena;
+    Model room(roomData.get(), false, roomOptions);
     room.SetShaderTextureNamePrefix("material.");
 
-    Model table("resources/objects/sto_iz_blendera/table.obj");
+    // the furniture uses the compact vertex layout, the room keeps full floats so its tiled texture coordinates keep their precision
+    ModelOptions packedModel;
+    packedModel.vertexFormat = VertexFormat::Packed;
+    packedModel.residency = GeometryResidency::Drop;
+    packedModel.arena = &packedArena;
+
+    Model table(tableData.get(), false, packedModel);
     table.SetShaderTextureNamePrefix("material.");
 
-    Model chair("resources/objects/stolica/Lucien_Lilippe_Chaise_Louis_XVI/Chaise_louisXVI_deco2.obj");
+    Model chair(chairData.get(), false, packedModel);
     chair.SetShaderTextureNamePrefix("material.");
 
-    Model teapot("resources/objects/teapot/teapot_n_glass.obj");
+    Model teapot(teapotData.get(), false, packedModel);
     teapot.SetShaderTextureNamePrefix("material.");
 
-    Model cup("resources/objects/soljica/cup.obj");
+    Model cup(cupData.get(), false, packedModel);
     cup.SetShaderTextureNamePrefix("material.");
 
+    // shader configuration
+    // the programs were only submitted above and compiled by the driver while the models loaded, the first use
+    // of each waits for its build
+    for (Shader &screenShader : screenShaders)
+    {
+        screenShader.use();
+        screenShader.setInt("screenTexture", 0);
+    }
+
+    for (Shader &paintingShader : paintingShaders)
+    {
+        paintingShader.use();
+        paintingShader.setInt("material.diffuse", 0);
+        paintingShader.setInt("material.specular", 1);
+        paintingShader.setFloat("material.shininess", 64.0f);
+    }
+    for (Shader &roomShader : roomShaders)
+    {
+        roomShader.use();
+        roomShader.setFloat("material.shininess", 2.0f);
+    }
+    for (Shader &modelsShader : modelsShaders)
+    {
+        modelsShader.use();
+        modelsShader.setFloat("material.shininess", 16.0f);
+    }
+
+    // camera and light state is shared through uniform blocks
+    UniformBuffer<CameraBlock> cameraBuffer(CAMERA_BLOCK_BINDING);
+    // the Lights block has the same layout in every program that declares it (std140), any of them describes it
+    UniformBlockLayout lightsLayout(roomShaders.variant({false, false}).ID, "Lights");
+    UniformStruct<PointLight> pointLightUniform = lightsLayout.bind<PointLight>("pointLight");
+    UniformStruct<SpotLight> spotLightUniform = lightsLayout.bind<SpotLight>("spotLight");
+    UniformBlockBuffer lightsBuffer(lightsLayout, LIGHTS_BLOCK_BINDING);
+    for (ShaderVariants *variants : {&roomShaders, &modelsShaders, &paintingShaders, &lightShaders})
+        for (Shader &shader : *variants)
+        {
+            shader.bindUniformBlock("Camera", CAMERA_BLOCK_BINDING);
+            shader.bindUniformBlock("Lights", LIGHTS_BLOCK_BINDING);
+        }
+
 
     PointLight& pointLight = programState->pointLight;
     pointLight.position = glm::vec3(0.0f, 3.0f, 0.0f);
@@ -394,6 +486,31 @@ int main() {
     spotLight.cutOff = glm::cos(glm::radians(12.5f));
     spotLight.outerCutOff = glm::cos(glm::radians(20.0f));
 
+    // the transform uniforms change for every draw, look their locations up once
+    TransformUniforms roomTransformUniforms = {roomShaders.uniform("model"), roomShaders.uniform("normalMatrix")};
+    TransformUniforms modelsTransformUniforms = {modelsShaders.uniform("model"), modelsShaders.uniform("normalMatrix")};
+    TransformUniforms paintingTransformUniforms = {paintingShaders.uniform("model"), paintingShaders.uniform("normalMatrix")};
+    // the lamp is unlit, its programs have no normalMatrix and the handle stays unused
+    TransformUniforms lampTransformUniforms = {lightShaders.uniform("model"), lightShaders.uniform("normalMatrix")};
+
+    // every placed object keeps its transform, the normal matrices are only recomputed when an object moves
+    Transform roomTransform, tableTransform, rightChairTransform, leftChairTransform, teapotTransform,
+              frontCupTransform, backCupTransform, lampTransform, paintingTransform;
+
+    // the painting samples the diffuse and specular maps set up above, its samplers point at units 0 and 1 already
+    Material paintingMaterial;
+    paintingMaterial.textures = {diffuseMap, specularMap};
+    paintingMaterial.samplers = {"", ""};
+
+    RenderQueue renderQueue;
+
+    // GPU time of the lit geometry (room, furniture, lamp and painting), reported on exit
+    GpuTimer litPassTimer;
+
+    // level of detail selection, every placement of a model remembers its levels for the hysteresis
+    LodView lodView;
+    LodState tableLod, rightChairLod, leftChairLod, teapotLod, frontCupLod, backCupLod;
+
     // render loop
     while (!glfwWindowShouldClose(window)) {
         // per-frame time logic
@@ -405,6 +522,23 @@ int main() {
         // input
         processInput(window);
 
+        // shader hot reload, the programs built from an edited file keep rendering until their rebuild linked
+        std::vector<std::string> changedShaders = shaderWatcher.changes();
+        for (ShaderVariants *variants : {&roomShaders, &modelsShaders, &lightShaders, &paintingShaders, &screenShaders})
+        {
+            variants->reload(changedShaders);
+            Shader *swapped = variants->swapReloaded();
+            // an edit of lights.glsl can reorder or retype the Lights block, the light structs are mapped onto
+            // the layout of the new program. The programs not swapped in yet read the old layout until they are.
+            if (swapped && glGetUniformBlockIndex(swapped->ID, "Lights") != GL_INVALID_INDEX)
+            {
+                UniformBlockLayout reloadedLayout(swapped->ID, "Lights");
+                pointLightUniform = reloadedLayout.bind<PointLight>("pointLight");
+                spotLightUniform = reloadedLayout.bind<SpotLight>("spotLight");
+                lightsBuffer.resize(reloadedLayout);
+            }
+        }
+
         //camera inside
         if (programState->camera.Position.x < -2.9)
             programState->camera.Position.x = -2.9;
@@ -431,219 +565,198 @@ int main() {
 
 
         // render
-        glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
+        // state changes go through GLState, which drops the ones that would not change anything
+        GLState &glState = GLState::instance();
+        glState.clearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-        glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
+        glState.bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glState.clearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glEnable(GL_DEPTH_TEST);
+        glState.enable(GL_DEPTH_TEST);
 
-        //room lights
-        roomShader.use();
-        roomShader.setVec3("pointLight.position", pointLight.position);
-        roomShader.setVec3("pointLight.ambient", pointLight.ambient);
-        roomShader.setVec3("pointLight.diffuse", pointLight.diffuse);
-        roomShader.setVec3("pointLight.specular", pointLight.specular);
-        roomShader.setFloat("pointLight.constant", pointLight.constant);
-        roomShader.setFloat("pointLight.linear", pointLight.linear);
-        roomShader.setFloat("pointLight.quadratic", pointLight.quadratic);
-        roomShader.setVec3("viewPosition", programState->camera.Position);
-        roomShader.setFloat("material.shininess", 2.0f);
-
-        roomShader.setVec3("spotLight.position", programState->camera.Position);
-        roomShader.setVec3("spotLight.direction", programState->camera.Front);
-        roomShader.setVec3("spotLight.ambient", spotLight.ambient);
-        roomShader.setVec3("spotLight.diffuse", spotLight.diffuse);
-        roomShader.setVec3("spotLight.specular", spotLight.specular);
-        roomShader.setFloat("spotLight.constant", spotLight.constant);
-        roomShader.setFloat("spotLight.linear", spotLight.linear);
-        roomShader.setFloat("spotLight.quadratic", spotLight.quadratic);
-        roomShader.setFloat("spotLight.cutOff", spotLight.cutOff);
-        roomShader.setFloat("spotLight.outerCutOff", spotLight.outerCutOff);
-        roomShader.setBool("spotLightEnabled", programState->spotLightEnabled);
-
-        //models lights
-        modelsShader.use();
-        modelsShader.setVec3("viewPosition", programState->camera.Position);
-        modelsShader.setFloat("material.shininess", 16.0f);
-
-        modelsShader.setVec3("pointLight.position", pointLight.position);
-        modelsShader.setVec3("pointLight.ambient", pointLight.ambient);
-        modelsShader.setVec3("pointLight.diffuse", pointLight.diffuse);
-        modelsShader.setVec3("pointLight.specular", pointLight.specular);
-        modelsShader.setFloat("pointLight.constant", pointLight.constant);
-        modelsShader.setFloat("pointLight.linear", pointLight.linear);
-        modelsShader.setFloat("pointLight.quadratic", pointLight.quadratic);
-
-        modelsShader.setVec3("spotLight.position", programState->camera.Position);
-        modelsShader.setVec3("spotLight.direction", programState->camera.Front);
-        modelsShader.setVec3("spotLight.ambient", spotLight.ambient);
-        modelsShader.setVec3("spotLight.diffuse", spotLight.diffuse);
-        modelsShader.setVec3("spotLight.specular", spotLight.specular);
-        modelsShader.setFloat("spotLight.constant", spotLight.constant);
-        modelsShader.setFloat("spotLight.linear", spotLight.linear);
-        modelsShader.setFloat("spotLight.quadratic", spotLight.quadratic);
-        modelsShader.setFloat("spotLight.cutOff", spotLight.cutOff);
-        modelsShader.setFloat("spotLight.outerCutOff", spotLight.outerCutOff);
-        modelsShader.setBool("spotLightEnabled", programState->spotLightEnabled);
-
-        lightShader.use();
-        lightShader.setBool("spotLightEnabled", programState->spotLightEnabled);
-
-        paintingShader.use();
-        paintingShader.use();
-        paintingShader.setVec3("light.position", pointLight.position);
-        paintingShader.setVec3("viewPos", programState->camera.Position);
-
-        // light properties
-        paintingShader.setVec3("light.ambient", 0.2f, 0.2f, 0.2f);
-        paintingShader.setVec3("light.diffuse", 0.5f, 0.5f, 0.5f);
-        paintingShader.setVec3("light.specular", 1.0f, 1.0f, 1.0f);
-
-        // material properties
-        paintingShader.setFloat("material.shininess", 64.0f);
-        paintingShader.setVec3("pointLight.position", pointLight.position);
-        paintingShader.setVec3("pointLight.ambient", pointLight.ambient);
-        paintingShader.setVec3("pointLight.diffuse", pointLight.diffuse);
-        paintingShader.setVec3("pointLight.specular", pointLight.specular);
-        paintingShader.setFloat("pointLight.constant", pointLight.constant);
-        paintingShader.setFloat("pointLight.linear", pointLight.linear);
-        paintingShader.setFloat("pointLight.quadratic", pointLight.quadratic);
-//
-
-        paintingShader.setVec3("spotLight.position", programState->camera.Position);
-        paintingShader.setVec3("spotLight.direction", programState->camera.Front);
-        paintingShader.setVec3("spotLight.ambient", spotLight.ambient);
-        paintingShader.setVec3("spotLight.diffuse", spotLight.diffuse);
-        paintingShader.setVec3("spotLight.specular", spotLight.specular);
-        paintingShader.setFloat("spotLight.constant", spotLight.constant);
-        paintingShader.setFloat("spotLight.linear", spotLight.linear);
-        paintingShader.setFloat("spotLight.quadratic", spotLight.quadratic);
-        paintingShader.setFloat("spotLight.cutOff", spotLight.cutOff);
-        paintingShader.setFloat("spotLight.outerCutOff", spotLight.outerCutOff);
-        paintingShader.setBool("spotLightEnabled", programState->spotLightEnabled);
-
-        screenShader.use();
-        screenShader.setBool("blurEnabled", programState->blurEnabled);
-
-        // view/projection transformations
-        roomShader.use();
+        // camera and lights, shared by all programs through uniform buffers. The buffers are only written when
+        // their contents changed since the last frame.
         glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
                                                 (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
         glm::mat4 view = programState->camera.GetViewMatrix();
-        roomShader.setMat4("projection", projection);
-        roomShader.setMat4("view", view);
-
-
+        lodView.cameraPosition = programState->camera.Position;
+        lodView.pixelsPerUnit = framebufferHeight / (2.0f * tan(glm::radians(programState->camera.Zoom) / 2.0f));
+
+        CameraBlock camera = {};
+        camera.projection = projection;
+        camera.view = view;
+        camera.viewPosition = programState->camera.Position;
+        cameraBuffer.update(camera);
+
+        lightsBuffer.set(pointLightUniform, pointLight);
+        // the spot light is a flashlight held by the camera
+        SpotLight flashlight = spotLight;
+        flashlight.position = programState->camera.Position;
+        flashlight.direction = programState->camera.Front;
+        lightsBuffer.set(spotLightUniform, flashlight);
+        lightsBuffer.update();
+
+        // pick the program variants matching the toggles
+        Shader &roomShader = roomShaders.variant({programState->spotLightEnabled, false});
+        Shader &instancedRoomShader = roomShaders.variant({programState->spotLightEnabled, true});
+        Shader &modelsShader = modelsShaders.variant({programState->spotLightEnabled, false});
+        Shader &instancedModelsShader = modelsShaders.variant({programState->spotLightEnabled, true});
+        Shader &lightShader = lightShaders.variant({programState->spotLightEnabled});
+        Shader &paintingShader = paintingShaders.variant({programState->spotLightEnabled});
+        Shader &screenShader = screenShaders.variant({programState->blurEnabled});
+
+        // the lit geometry goes through the render queue, which orders the draws by program, textures and
+        // vertex array instead of the order they are listed in
+        if (programState->multiDrawEnabled && !RenderQueue::multiDrawIndirectSupported() && !renderQueue.multiDrawEnabled())
+            std::cout << "ERROR::RENDER_QUEUE:: multi draw indirect is not supported, the commands are drawn one by one" << std::endl;
+        renderQueue.setMultiDraw(programState->multiDrawEnabled);
+        // meshes outside the view are dropped by the queue before they reach GL
+        renderQueue.begin(programState->camera.Position, Frustum::fromMatrix(projection * view));
+
+        DrawItem roomItem;
+        roomItem.shader = &roomShader;
+        roomItem.instancedShader = &instancedRoomShader;
+        roomItem.transform = &roomTransform;
+        roomItem.transformUniforms = roomTransformUniforms;
         glm::mat4 model = glm::mat4(1.0f);
         model = glm::translate(model,
                                programState->roomPosition); // translate it down so it's at the center of the scene
         //model = glm::rotate(model, glm::radians(40.0f), glm::vec3(1.0,1.0 ,0.0));
         model = glm::scale(model, glm::vec3(programState->roomScale));    // it's a bit too big for our scene, so scale it down
-        roomShader.setMat4("model", model);
-        room.Draw(roomShader);
+        roomTransform.set(model);
+        room.Draw(renderQueue, roomItem);
 
-        modelsShader.use();
-        modelsShader.setMat4("projection", projection);
-        modelsShader.setMat4("view", view);
+        DrawItem modelsItem;
+        modelsItem.shader = &modelsShader;
+        modelsItem.instancedShader = &instancedModelsShader;
+        modelsItem.transformUniforms = modelsTransformUniforms;
 
         model = glm::translate(model, glm::vec3(0.0, -0.55, 0.0));
         //model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0, 0.0, 0.0));
         model = glm::scale(model, glm::vec3(0.2, 0.25, 0.2));    // it's a bit too big for our scene, so scale it down
-        modelsShader.setMat4("model", model);
-        table.Draw(modelsShader);
-
-
-        modelsShader.use();
+        tableTransform.set(model);
+        modelsItem.transform = &tableTransform;
+        table.Draw(renderQueue, modelsItem, lodView, tableLod);
 
         model = glm::mat4(1.0);
         model = glm::translate(model,
                                programState->roomPosition + glm::vec3(0.5, 0.0, 0.0));
         model = glm::rotate(model, glm::radians(-25.0f), glm::vec3(0.0, 1.0, 0.0));
         model = glm::scale(model, glm::vec3(1.5));
-        modelsShader.setMat4("model", model);
-        chair.Draw(modelsShader);
+        rightChairTransform.set(model);
+        modelsItem.transform = &rightChairTransform;
+        chair.Draw(renderQueue, modelsItem, lodView, rightChairLod);
 
         model = glm::mat4(1.0);
         model = glm::translate(model,
                                programState->roomPosition + glm::vec3(-0.5, 0.0, 0.0));
         model = glm::rotate(model, glm::radians(155.0f), glm::vec3(0.0, 1.0, 0.0));
         model = glm::scale(model, glm::vec3(1.5));
-        modelsShader.setMat4("model", model);
-        chair.Draw(modelsShader);
+        leftChairTransform.set(model);
+        modelsItem.transform = &leftChairTransform;
+        chair.Draw(renderQueue, modelsItem, lodView, leftChairLod);
         model = glm::mat4(1.0);
         model = glm::translate(model,
                                programState->roomPosition + glm::vec3(-0.65, 0.415, 0.45));
         //model = glm::scale(model, glm::vec3(0.65));
-        modelsShader.setMat4("model", model);
-        teapot.Draw(modelsShader);
+        teapotTransform.set(model);
+        modelsItem.transform = &teapotTransform;
+        teapot.Draw(renderQueue, modelsItem, lodView, teapotLod);
 
         model = glm::mat4(1.0);
         model = glm::translate(model,
                                programState->roomPosition + glm::vec3(0.0, 1.15, 0.58));
         model = glm::scale(model, glm::vec3(0.5));
-        modelsShader.setMat4("model", model);
-        cup.Draw(modelsShader);
+        frontCupTransform.set(model);
+        modelsItem.transform = &frontCupTransform;
+        cup.Draw(renderQueue, modelsItem, lodView, frontCupLod);
 
         model = glm::mat4(1.0);
         model = glm::translate(model,
                                programState->roomPosition + glm::vec3(0.0, 1.15, -0.58));
         model = glm::scale(model, glm::vec3(0.5));
-        modelsShader.setMat4("model", model);
-        cup.Draw(modelsShader);
+        backCupTransform.set(model);
+        modelsItem.transform = &backCupTransform;
+        cup.Draw(renderQueue, modelsItem, lodView, backCupLod);
 
         //draw the lamp object
-        lightShader.use();
-        lightShader.setMat4("projection", projection);
-        lightShader.setMat4("view", view);
-
         model = glm::mat4(1.0f);
         model = glm::translate(model, pointLight.position);
         model = glm::scale(model, glm::vec3(0.3f));
-        lightShader.setMat4("model", model);
-        glBindVertexArray(VAO1);
-        glDrawElements(GL_TRIANGLES, 60, GL_UNSIGNED_INT, 0);
+        lampTransform.set(model);
+        DrawItem lampItem;
+        lampItem.shader = &lightShader;
+        lampItem.transform = &lampTransform;
+        lampItem.transformUniforms = lampTransformUniforms;
+        lampItem.vao = VAO1;
+        lampItem.indexType = GL_UNSIGNED_SHORT;
+        lampItem.count = 60;
+        renderQueue.submit(lampItem, pointLight.position);
 
 
         //painting
-
-        paintingShader.use();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, diffuseMap);
-        // bind specular map
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, specularMap);
-        //draw the painting object
-
-        paintingShader.setMat4("projection", projection);
-        paintingShader.setMat4("view", view);
         model = glm::mat4(1.0);
         model = glm::translate(model, programState->roomPosition + glm::vec3(3.3 , 1.8 + programState->deltaY, 0.0 + programState->deltaZ));
         model = glm::scale(model, glm::vec3(0.1,1.1, 1.0));
-        paintingShader.setMat4("model", model);
-        glBindVertexArray(VAO2);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-
-        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, intermediateFBO);
+        paintingTransform.set(model);
+        DrawItem paintingItem;
+        paintingItem.shader = &paintingShader;
+        paintingItem.transform = &paintingTransform;
+        paintingItem.transformUniforms = paintingTransformUniforms;
+        paintingItem.material = &paintingMaterial;
+        paintingItem.vao = VAO2;
+        paintingItem.count = 36;
+        renderQueue.submit(paintingItem, glm::vec3(model[3]));
+
+        litPassTimer.begin();
+        renderQueue.execute();
+        litPassTimer.end();
+
+        glState.bindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glState.bindFramebuffer(GL_DRAW_FRAMEBUFFER, intermediateFBO);
         glBlitFramebuffer(0, 0, SCR_WIDTH, SCR_HEIGHT, 0, 0, SCR_WIDTH, SCR_HEIGHT, GL_COLOR_BUFFER_BIT, GL_NEAREST);
 
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+        glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
+        glState.clearColor(1.0f, 1.0f, 1.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
-        glDisable(GL_DEPTH_TEST);
+        glState.disable(GL_DEPTH_TEST);
 
         screenShader.use();
-        glBindVertexArray(quadVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, screenTexture);
+        glState.bindVertexArray(quadVAO);
+        glState.bindTexture(0, GL_TEXTURE_2D, screenTexture);
         glDrawArrays(GL_TRIANGLES, 0, 6);
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         glfwSwapBuffers(window);
         glfwPollEvents();
+        glState.endFrame();
+    }
+
+    const UniformUploadStats &uniformUploads = uniformUploadStats();
+    std::cout << "SHADER:: uniform uploads issued " << uniformUploads.issued << ", elided " << uniformUploads.elided << std::endl;
+    const RenderQueueStats &queueStats = renderQueue.statistics();
+    if (queueStats.frames)
+    {
+        double frames = (double)queueStats.frames;
+        std::cout << "RENDER_QUEUE:: " << queueStats.draws / frames << " visible draws per frame ("
+                  << queueStats.culled / frames << " culled) in " << queueStats.drawCalls / frames
+                  << " draw calls (" << queueStats.commands / frames << " instanced commands), state changes per frame in submission order: programs "
+                  << queueStats.submitted.programs / frames << ", vertex arrays " << queueStats.submitted.vertexArrays / frames
+                  << ", textures " << queueStats.submitted.textures / frames << "; sorted: programs " << queueStats.sorted.programs / frames
+                  << ", vertex arrays " << queueStats.sorted.vertexArrays / frames << ", textures " << queueStats.sorted.textures / frames
+                  << "; merged: programs " << queueStats.merged.programs / frames << ", vertex arrays " << queueStats.merged.vertexArrays / frames
+                  << ", textures " << queueStats.merged.textures / frames << std::endl;
+    }
+    const GLState &glState = GLState::instance();
+    if (glState.frameCount())
+    {
+        double frames = (double)glState.frameCount();
+        std::cout << "GL_STATE:: state calls per frame issued " << glState.totals().issued / frames
+                  << ", elided " << glState.totals().elided / frames << std::endl;
     }
+    double litPassMilliseconds = litPassTimer.averageMilliseconds();
+    std::cout << "GPU:: lit passes " << litPassMilliseconds << " ms per frame over " << litPassTimer.sampleCount() << " frames" << std::endl;
 
     glDeleteVertexArrays(1, &VAO1);
     glDeleteBuffers(1, &VBO1);
@@ -656,6 +769,12 @@ int main() {
 
     //glDeleteBuffers(1, &EBO);
 
+    // models release their textures and the arenas would release their buffers when they go out of scope, which
+    // happens after the context is gone
+    TextureManager::instance().clear();
+    fullArena.release();
+    packedArena.release();
+
     programState->SaveToFile("resources/program_state.txt");
     delete programState;
     // glfw: terminate, clearing all previously allocated GLFW resources.
@@ -678,6 +797,11 @@ void processInput(GLFWwindow *window) {
     if (glfwGetKey(window, GLFW_KEY_U) == GLFW_PRESS)
         programState->blurEnabled = false;
 
+    if (glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS)
+        programState->multiDrawEnabled = true;
+    if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS)
+        programState->multiDrawEnabled = false;
+
 
     if(glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
         programState->deltaY += 0.01;
@@ -703,7 +827,8 @@ void processInput(GLFWwindow *window) {
 void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
     // make sure the viewport matches the new window dimensions; note that width and
     // height will be significantly larger than specified on retina displays.
-    glViewport(0, 0, width, height);
+    GLState::instance().viewport(0, 0, width, height);
+    framebufferHeight = height;
 }
 
 // glfw: whenever the mouse moves, this callback is called
@@ -728,40 +853,3 @@ void mouse_callback(GLFWwindow *window, double xpos, double ypos) {
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
     programState->camera.ProcessMouseScroll(yoffset);
 }
-
-unsigned int loadTexture(char const * path)
-{
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
-}
\ No newline at end of file